@@ -0,0 +1,8 @@
+/*
+ * Poly1305 authenticator algorithm, RFC7539, ARM NEON functions
+ *
+ * The NEON intrinsics used by the arm64 version are available on ARMv7
+ * as well, so simply build the same source with -mfpu=neon.
+ */
+
+#include "../../arm64/crypto/poly1305-neon-core.c"
@@ -0,0 +1,191 @@
+/*
+ * Poly1305 authenticator algorithm, RFC7539, NEON functions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Based on:
+ * Poly1305 authenticator algorithm, RFC7539, x64 SSE2 functions
+ *
+ * Copyright (C) 2015 Martin Willi
+ *
+ * This file is built with NEON enabled and without any kernel headers, so
+ * it may only be called between kernel_neon_begin() and kernel_neon_end().
+ * It is shared with 32-bit ARM, see arch/arm/crypto/poly1305-neon-core.c.
+ */
+
+#include <arm_neon.h>
+
+#define MASK26	0x3ffffff
+#define HIBIT	(1 << 24)
+
+void poly1305_block_neon(uint32_t *h, const uint8_t *src,
+			 const uint32_t *r, unsigned int blocks);
+void poly1305_2block_neon(uint32_t *h, const uint8_t *src,
+			  const uint32_t *r, unsigned int blocks,
+			  const uint32_t *u);
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+	uint32_t v;
+
+	__builtin_memcpy(&v, p, sizeof(v));
+#if defined(__ARMEB__) || defined(__AARCH64EB__)
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+static inline uint32x2_t pair(uint32_t lo, uint32_t hi)
+{
+	return vset_lane_u32(hi, vdup_n_u32(lo), 1);
+}
+
+static inline uint64_t hsum(uint64x2_t d)
+{
+	return vgetq_lane_u64(d, 0) + vgetq_lane_u64(d, 1);
+}
+
+/*
+ * Carry-propagate the five 64-bit product limbs back into five 26-bit
+ * accumulator limbs, folding the bits above 2^130 back in times 5.
+ */
+static inline void poly1305_reduce(uint32_t *h, uint64_t d0, uint64_t d1,
+				   uint64_t d2, uint64_t d3, uint64_t d4)
+{
+	uint32_t c;
+
+	c = (uint32_t)(d0 >> 26);
+	h[0] = d0 & MASK26;
+	d1 += c;
+	c = (uint32_t)(d1 >> 26);
+	h[1] = d1 & MASK26;
+	d2 += c;
+	c = (uint32_t)(d2 >> 26);
+	h[2] = d2 & MASK26;
+	d3 += c;
+	c = (uint32_t)(d3 >> 26);
+	h[3] = d3 & MASK26;
+	d4 += c;
+	c = (uint32_t)(d4 >> 26);
+	h[4] = d4 & MASK26;
+	h[0] += c * 5;
+	c = h[0] >> 26;
+	h[0] &= MASK26;
+	h[1] += c;
+}
+
+/* h = (h + m) * r, for each 16-byte block m, with the 2^128 bit set */
+void poly1305_block_neon(uint32_t *h, const uint8_t *src,
+			 const uint32_t *r, unsigned int blocks)
+{
+	uint32_t r0 = r[0], r1 = r[1], r2 = r[2], r3 = r[3], r4 = r[4];
+	uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0, h1, h2, h3, h4;
+	uint64_t d0, d1, d2, d3, d4;
+
+	while (blocks--) {
+		h0 = h[0] + ((get_le32(src +  0) >> 0) & MASK26);
+		h1 = h[1] + ((get_le32(src +  3) >> 2) & MASK26);
+		h2 = h[2] + ((get_le32(src +  6) >> 4) & MASK26);
+		h3 = h[3] + ((get_le32(src +  9) >> 6) & MASK26);
+		h4 = h[4] + ((get_le32(src + 12) >> 8) | HIBIT);
+
+		d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 +
+		     (uint64_t)h2 * s3 + (uint64_t)h3 * s2 +
+		     (uint64_t)h4 * s1;
+		d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 +
+		     (uint64_t)h2 * s4 + (uint64_t)h3 * s3 +
+		     (uint64_t)h4 * s2;
+		d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 +
+		     (uint64_t)h2 * r0 + (uint64_t)h3 * s4 +
+		     (uint64_t)h4 * s3;
+		d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 +
+		     (uint64_t)h2 * r1 + (uint64_t)h3 * r0 +
+		     (uint64_t)h4 * s4;
+		d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 +
+		     (uint64_t)h2 * r2 + (uint64_t)h3 * r1 +
+		     (uint64_t)h4 * r0;
+
+		poly1305_reduce(h, d0, d1, d2, d3, d4);
+
+		src += 16;
+	}
+}
+
+/*
+ * h = (h + m0) * r^2 + m1 * r, for each pair of 16-byte blocks m0, m1.
+ *
+ * Lane 0 carries (h + m0) multiplied by u = r^2, lane 1 carries m1
+ * multiplied by r, so each vmull/vmlal computes one partial product for
+ * both blocks at once. The lanes are summed before the carry chain.
+ */
+void poly1305_2block_neon(uint32_t *h, const uint8_t *src,
+			  const uint32_t *r, unsigned int blocks,
+			  const uint32_t *u)
+{
+	const uint32x2_t r0 = pair(u[0], r[0]);
+	const uint32x2_t r1 = pair(u[1], r[1]);
+	const uint32x2_t r2 = pair(u[2], r[2]);
+	const uint32x2_t r3 = pair(u[3], r[3]);
+	const uint32x2_t r4 = pair(u[4], r[4]);
+	const uint32x2_t s1 = vmul_n_u32(r1, 5);
+	const uint32x2_t s2 = vmul_n_u32(r2, 5);
+	const uint32x2_t s3 = vmul_n_u32(r3, 5);
+	const uint32x2_t s4 = vmul_n_u32(r4, 5);
+	uint32x2_t h0, h1, h2, h3, h4;
+	uint64x2_t d0, d1, d2, d3, d4;
+	const uint8_t *m0, *m1;
+
+	while (blocks--) {
+		m0 = src;
+		m1 = src + 16;
+
+		h0 = pair(h[0] + ((get_le32(m0 +  0) >> 0) & MASK26),
+			  (get_le32(m1 +  0) >> 0) & MASK26);
+		h1 = pair(h[1] + ((get_le32(m0 +  3) >> 2) & MASK26),
+			  (get_le32(m1 +  3) >> 2) & MASK26);
+		h2 = pair(h[2] + ((get_le32(m0 +  6) >> 4) & MASK26),
+			  (get_le32(m1 +  6) >> 4) & MASK26);
+		h3 = pair(h[3] + ((get_le32(m0 +  9) >> 6) & MASK26),
+			  (get_le32(m1 +  9) >> 6) & MASK26);
+		h4 = pair(h[4] + ((get_le32(m0 + 12) >> 8) | HIBIT),
+			  (get_le32(m1 + 12) >> 8) | HIBIT);
+
+		d0 = vmull_u32(h0, r0);
+		d0 = vmlal_u32(d0, h1, s4);
+		d0 = vmlal_u32(d0, h2, s3);
+		d0 = vmlal_u32(d0, h3, s2);
+		d0 = vmlal_u32(d0, h4, s1);
+
+		d1 = vmull_u32(h0, r1);
+		d1 = vmlal_u32(d1, h1, r0);
+		d1 = vmlal_u32(d1, h2, s4);
+		d1 = vmlal_u32(d1, h3, s3);
+		d1 = vmlal_u32(d1, h4, s2);
+
+		d2 = vmull_u32(h0, r2);
+		d2 = vmlal_u32(d2, h1, r1);
+		d2 = vmlal_u32(d2, h2, r0);
+		d2 = vmlal_u32(d2, h3, s4);
+		d2 = vmlal_u32(d2, h4, s3);
+
+		d3 = vmull_u32(h0, r3);
+		d3 = vmlal_u32(d3, h1, r2);
+		d3 = vmlal_u32(d3, h2, r1);
+		d3 = vmlal_u32(d3, h3, r0);
+		d3 = vmlal_u32(d3, h4, s4);
+
+		d4 = vmull_u32(h0, r4);
+		d4 = vmlal_u32(d4, h1, r3);
+		d4 = vmlal_u32(d4, h2, r2);
+		d4 = vmlal_u32(d4, h3, r1);
+		d4 = vmlal_u32(d4, h4, r0);
+
+		poly1305_reduce(h, hsum(d0), hsum(d1), hsum(d2), hsum(d3),
+				hsum(d4));
+
+		src += 32;
+	}
+}
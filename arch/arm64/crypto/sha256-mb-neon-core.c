@@ -0,0 +1,144 @@
+/*
+ * Multi buffer SHA-256, 4 lanes, NEON functions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Each 32-bit lane of a NEON register carries the same SHA-256 working
+ * variable of a different, independent message, so every instruction of
+ * the compression function advances four hashes at once. This follows
+ * the transposed layout of the x86 sha256_x8_avx2 code.
+ *
+ * This file is built with NEON enabled and without any kernel headers, so
+ * it may only be called between kernel_neon_begin() and kernel_neon_end().
+ */
+
+#include <arm_neon.h>
+
+void sha256_x4_neon(uint32_t (*digest)[4], uint8_t **data,
+		    unsigned int blocks);
+
+static const uint32_t K256[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n)	vsriq_n_u32(vshlq_n_u32((x), 32 - (n)), (x), (n))
+
+#define S0(x)	veorq_u32(veorq_u32(ROR(x, 2), ROR(x, 13)), ROR(x, 22))
+#define S1(x)	veorq_u32(veorq_u32(ROR(x, 6), ROR(x, 11)), ROR(x, 25))
+#define s0(x)	veorq_u32(veorq_u32(ROR(x, 7), ROR(x, 18)), vshrq_n_u32(x, 3))
+#define s1(x)	veorq_u32(veorq_u32(ROR(x, 17), ROR(x, 19)), vshrq_n_u32(x, 10))
+
+/* Ch(e, f, g) picks f where e is set, g elsewhere */
+#define CH(e, f, g)	vbslq_u32((e), (f), (g))
+/* where a and b differ, c has the majority, elsewhere it's b */
+#define MAJ(a, b, c)	vbslq_u32(veorq_u32((a), (b)), (c), (b))
+
+static inline uint32x4_t load_be32(const uint8_t *p)
+{
+#ifdef __AARCH64EB__
+	return vld1q_u32((const uint32_t *)p);
+#else
+	return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p)));
+#endif
+}
+
+/*
+ * Load message words 4i..4i+3 of all lanes and transpose them, so that
+ * w[4i + j] holds word 4i + j of lane 0..3.
+ */
+static inline void load_words(uint32x4_t *w, uint8_t **data, int i)
+{
+	uint32x4_t l0 = load_be32(data[0] + 16 * i);
+	uint32x4_t l1 = load_be32(data[1] + 16 * i);
+	uint32x4_t l2 = load_be32(data[2] + 16 * i);
+	uint32x4_t l3 = load_be32(data[3] + 16 * i);
+	uint32x4x2_t t0 = vtrnq_u32(l0, l1);
+	uint32x4x2_t t1 = vtrnq_u32(l2, l3);
+
+	w[4 * i + 0] = vcombine_u32(vget_low_u32(t0.val[0]),
+				    vget_low_u32(t1.val[0]));
+	w[4 * i + 1] = vcombine_u32(vget_low_u32(t0.val[1]),
+				    vget_low_u32(t1.val[1]));
+	w[4 * i + 2] = vcombine_u32(vget_high_u32(t0.val[0]),
+				    vget_high_u32(t1.val[0]));
+	w[4 * i + 3] = vcombine_u32(vget_high_u32(t0.val[1]),
+				    vget_high_u32(t1.val[1]));
+}
+
+/*
+ * Hash 'blocks' 64-byte blocks from each of the four data pointers into
+ * the transposed digest, where digest[i][lane] is word i of that lane's
+ * state, and advance the data pointers past the consumed input.
+ */
+void sha256_x4_neon(uint32_t (*digest)[4], uint8_t **data,
+		    unsigned int blocks)
+{
+	uint32x4_t a, b, c, d, e, f, g, h, t1, t2;
+	uint32x4_t w[16];
+	int i, lane;
+
+	while (blocks--) {
+		a = vld1q_u32(digest[0]);
+		b = vld1q_u32(digest[1]);
+		c = vld1q_u32(digest[2]);
+		d = vld1q_u32(digest[3]);
+		e = vld1q_u32(digest[4]);
+		f = vld1q_u32(digest[5]);
+		g = vld1q_u32(digest[6]);
+		h = vld1q_u32(digest[7]);
+
+		for (i = 0; i < 4; i++)
+			load_words(w, data, i);
+
+		for (i = 0; i < 64; i++) {
+			if (i >= 16)
+				w[i & 15] = vaddq_u32(
+					vaddq_u32(w[i & 15], s0(w[(i + 1) & 15])),
+					vaddq_u32(w[(i + 9) & 15],
+						  s1(w[(i + 14) & 15])));
+
+			t1 = vaddq_u32(vaddq_u32(h, S1(e)), CH(e, f, g));
+			t1 = vaddq_u32(t1, vaddq_u32(w[i & 15],
+						     vdupq_n_u32(K256[i])));
+			t2 = vaddq_u32(S0(a), MAJ(a, b, c));
+
+			h = g;
+			g = f;
+			f = e;
+			e = vaddq_u32(d, t1);
+			d = c;
+			c = b;
+			b = a;
+			a = vaddq_u32(t1, t2);
+		}
+
+		vst1q_u32(digest[0], vaddq_u32(vld1q_u32(digest[0]), a));
+		vst1q_u32(digest[1], vaddq_u32(vld1q_u32(digest[1]), b));
+		vst1q_u32(digest[2], vaddq_u32(vld1q_u32(digest[2]), c));
+		vst1q_u32(digest[3], vaddq_u32(vld1q_u32(digest[3]), d));
+		vst1q_u32(digest[4], vaddq_u32(vld1q_u32(digest[4]), e));
+		vst1q_u32(digest[5], vaddq_u32(vld1q_u32(digest[5]), f));
+		vst1q_u32(digest[6], vaddq_u32(vld1q_u32(digest[6]), g));
+		vst1q_u32(digest[7], vaddq_u32(vld1q_u32(digest[7]), h));
+
+		for (lane = 0; lane < 4; lane++)
+			data[lane] += 64;
+	}
+}
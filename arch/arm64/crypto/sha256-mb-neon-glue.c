@@ -0,0 +1,85 @@
+/*
+ * Multi buffer SHA-256 algorithm glue code, arm64 NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Only the NEON job manager hooks live here, the ahash and mcryptd
+ * plumbing is shared with x86 in crypto/sha256_mb_glue.c.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <crypto/sha256_mb.h>
+#include <asm/hwcap.h>
+#include <asm/neon.h>
+#include "sha256-mb-neon.h"
+
+static void sha256_mb_neon_init(void *mgr)
+{
+	sha256_mb_mgr_init_neon(mgr);
+}
+
+static struct job_sha256 *sha256_mb_neon_submit(void *mgr,
+						struct job_sha256 *job)
+{
+	return sha256_mb_mgr_submit_neon(mgr, job);
+}
+
+static struct job_sha256 *sha256_mb_neon_flush(void *mgr)
+{
+	return sha256_mb_mgr_flush_neon(mgr);
+}
+
+static struct job_sha256 *sha256_mb_neon_get_comp_job(void *mgr)
+{
+	return sha256_mb_mgr_get_comp_job_neon(mgr);
+}
+
+static void sha256_mb_neon_begin(void)
+{
+	kernel_neon_begin();
+}
+
+static void sha256_mb_neon_end(void)
+{
+	kernel_neon_end();
+}
+
+static const struct sha256_mb_ops sha256_mb_neon_ops = {
+	.mgr_size		= sizeof(struct sha256_mb_mgr),
+	.mgr_init		= sha256_mb_neon_init,
+	.mgr_submit		= sha256_mb_neon_submit,
+	.mgr_flush		= sha256_mb_neon_flush,
+	.mgr_get_comp_job	= sha256_mb_neon_get_comp_job,
+	.simd_begin		= sha256_mb_neon_begin,
+	.simd_end		= sha256_mb_neon_end,
+	.internal_driver_name	= "__neon_sha256-mb",
+	.driver_name		= "sha256_mb_neon",
+	/* above sha256-arm64-neon, below sha256-ce */
+	.priority		= 160,
+	.owner			= THIS_MODULE,
+};
+
+static int __init sha256_mb_neon_mod_init(void)
+{
+	/* check for dependent cpu features */
+	if (!(elf_hwcap & HWCAP_ASIMD))
+		return -ENODEV;
+
+	return sha256_mb_register(&sha256_mb_neon_ops);
+}
+
+static void __exit sha256_mb_neon_mod_fini(void)
+{
+	sha256_mb_unregister(&sha256_mb_neon_ops);
+}
+
+module_init(sha256_mb_neon_mod_init);
+module_exit(sha256_mb_neon_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("SHA256 Secure Hash Algorithm, NEON multi buffer accelerated");
+
+MODULE_ALIAS_CRYPTO("sha256");
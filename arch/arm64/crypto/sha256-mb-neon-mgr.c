@@ -0,0 +1,122 @@
+/*
+ * Multi buffer SHA-256 job manager, arm64 NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * C version of the x86 sha256_mb_mgr_{init,submit,flush}_avx2 lane
+ * scheduler, driving the 4 lane sha256_x4_neon() core. Must be called
+ * between kernel_neon_begin() and kernel_neon_end().
+ */
+
+#include <linux/kernel.h>
+#include "sha256-mb-neon.h"
+
+#define LANE_IDLE	0xFFFFFFFF
+
+void sha256_mb_mgr_init_neon(struct sha256_mb_mgr *state)
+{
+	unsigned int j;
+
+	state->unused_lanes = 0xF3210;
+	for (j = 0; j < SHA256_MB_NEON_LANES; j++) {
+		state->lens[j] = LANE_IDLE;
+		state->ldata[j].job_in_lane = NULL;
+	}
+}
+
+/* retire the job in 'lane', whose blocks have all been hashed */
+static struct job_sha256 *sha256_mb_mgr_complete(struct sha256_mb_mgr *state,
+						 unsigned int lane)
+{
+	struct job_sha256 *job = state->ldata[lane].job_in_lane;
+	unsigned int i;
+
+	state->ldata[lane].job_in_lane = NULL;
+	state->lens[lane] = LANE_IDLE;
+	state->unused_lanes = (state->unused_lanes << 4) | lane;
+
+	for (i = 0; i < NUM_SHA256_DIGEST_WORDS; i++)
+		job->result_digest[i] = state->args.digest[i][lane];
+	job->status = STS_COMPLETED;
+
+	return job;
+}
+
+/*
+ * Hash all lanes for as many blocks as the shortest job has left, and
+ * retire that job. Idle lanes must point at valid data.
+ */
+static struct job_sha256 *sha256_mb_mgr_run(struct sha256_mb_mgr *state)
+{
+	u32 min = state->lens[0];
+	unsigned int i, len;
+
+	for (i = 1; i < SHA256_MB_NEON_LANES; i++)
+		min = min_t(u32, min, state->lens[i]);
+
+	len = min >> 4;
+	if (len) {
+		for (i = 0; i < SHA256_MB_NEON_LANES; i++)
+			if (state->lens[i] != LANE_IDLE)
+				state->lens[i] -= len << 4;
+		sha256_x4_neon(state->args.digest, state->args.data_ptr, len);
+	}
+
+	return sha256_mb_mgr_complete(state, min & 0xF);
+}
+
+struct job_sha256 *sha256_mb_mgr_submit_neon(struct sha256_mb_mgr *state,
+					     struct job_sha256 *job)
+{
+	unsigned int lane = state->unused_lanes & 0xF;
+	unsigned int i;
+
+	state->unused_lanes >>= 4;
+	job->status = STS_BEING_PROCESSED;
+	state->ldata[lane].job_in_lane = job;
+	state->lens[lane] = (job->len << 4) | lane;
+
+	for (i = 0; i < NUM_SHA256_DIGEST_WORDS; i++)
+		state->args.digest[i][lane] = job->result_digest[i];
+	state->args.data_ptr[lane] = job->buffer;
+
+	/* wait until all lanes are busy */
+	if (state->unused_lanes != 0xF)
+		return NULL;
+
+	return sha256_mb_mgr_run(state);
+}
+
+struct job_sha256 *sha256_mb_mgr_flush_neon(struct sha256_mb_mgr *state)
+{
+	unsigned int i, good = SHA256_MB_NEON_LANES;
+
+	for (i = 0; i < SHA256_MB_NEON_LANES; i++) {
+		if (state->ldata[i].job_in_lane) {
+			good = i;
+			break;
+		}
+	}
+	if (good == SHA256_MB_NEON_LANES)
+		return NULL;
+
+	/* let the idle lanes hash a copy of a busy lane's data */
+	for (i = 0; i < SHA256_MB_NEON_LANES; i++)
+		if (!state->ldata[i].job_in_lane)
+			state->args.data_ptr[i] = state->args.data_ptr[good];
+
+	return sha256_mb_mgr_run(state);
+}
+
+struct job_sha256 *sha256_mb_mgr_get_comp_job_neon(struct sha256_mb_mgr *state)
+{
+	unsigned int i;
+
+	for (i = 0; i < SHA256_MB_NEON_LANES; i++)
+		if (state->ldata[i].job_in_lane && !(state->lens[i] >> 4))
+			return sha256_mb_mgr_complete(state, i);
+
+	return NULL;
+}
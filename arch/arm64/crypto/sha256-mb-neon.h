@@ -0,0 +1,53 @@
+/*
+ * Multi buffer SHA-256 lane manager definitions, arm64 NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Based on arch/x86/crypto/sha256-mb/sha256_mb_mgr.h:
+ * Copyright(c) 2016 Intel Corporation.
+ */
+
+#ifndef __SHA256_MB_NEON_H
+#define __SHA256_MB_NEON_H
+
+#include <linux/types.h>
+#include <crypto/sha256_mb.h>
+
+#define SHA256_MB_NEON_LANES		4
+
+/* SHA256 out-of-order scheduler */
+
+struct sha256_args_x4 {
+	/* transposed: digest[i][lane] is word i of that lane */
+	u32	digest[NUM_SHA256_DIGEST_WORDS][SHA256_MB_NEON_LANES]
+							__aligned(16);
+	u8	*data_ptr[SHA256_MB_NEON_LANES];
+};
+
+struct sha256_lane_data {
+	struct job_sha256 *job_in_lane;
+};
+
+struct sha256_mb_mgr {
+	struct sha256_args_x4 args;
+
+	/* blocks left << 4 | lane index, ~0 for an idle lane */
+	u32 lens[SHA256_MB_NEON_LANES];
+
+	/* each nibble is the index of an unused lane, 0xF terminated */
+	u64 unused_lanes;
+	struct sha256_lane_data ldata[SHA256_MB_NEON_LANES];
+};
+
+void sha256_mb_mgr_init_neon(struct sha256_mb_mgr *state);
+struct job_sha256 *sha256_mb_mgr_submit_neon(struct sha256_mb_mgr *state,
+					     struct job_sha256 *job);
+struct job_sha256 *sha256_mb_mgr_flush_neon(struct sha256_mb_mgr *state);
+struct job_sha256 *sha256_mb_mgr_get_comp_job_neon(struct sha256_mb_mgr *state);
+
+void sha256_x4_neon(u32 (*digest)[SHA256_MB_NEON_LANES], u8 **data,
+		    unsigned int blocks);
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * Cryptographic API.
+ *
+ * LZMA2 compression, using the encoder and decoder from lib/xz.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * The compressed format is the LZMA2 properties byte (dictionary size)
+ * followed by a raw LZMA2 stream, without the .xz container headers.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/crypto.h>
+#include <linux/slab.h>
+#include <linux/xz.h>
+#include <crypto/internal/scompress.h>
+
+struct lzma2_ctx {
+	struct xz_enc_lzma2 *enc;
+	struct xz_dec_lzma2 *dec;
+};
+
+static unsigned int preset = 3;
+module_param(preset, uint, 0444);
+MODULE_PARM_DESC(preset, "Compression preset, 0 (fastest) to 9 (best ratio)");
+
+static void __lzma2_exit(struct lzma2_ctx *ctx)
+{
+	xz_enc_lzma2_end(ctx->enc);
+	if (ctx->dec)
+		xz_dec_lzma2_end(ctx->dec);
+}
+
+static int __lzma2_init(struct lzma2_ctx *ctx)
+{
+	ctx->enc = xz_enc_lzma2_init(min_t(unsigned int, preset,
+					   XZ_PRESET_MAX));
+	ctx->dec = xz_dec_lzma2_create(XZ_SINGLE, 0);
+	if (!ctx->enc || !ctx->dec) {
+		__lzma2_exit(ctx);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void *lzma2_alloc_ctx(struct crypto_scomp *tfm)
+{
+	struct lzma2_ctx *ctx;
+	int ret;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return ERR_PTR(-ENOMEM);
+
+	ret = __lzma2_init(ctx);
+	if (ret) {
+		kfree(ctx);
+		return ERR_PTR(ret);
+	}
+
+	return ctx;
+}
+
+static int lzma2_init(struct crypto_tfm *tfm)
+{
+	struct lzma2_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	return __lzma2_init(ctx);
+}
+
+static void lzma2_free_ctx(struct crypto_scomp *tfm, void *ctx)
+{
+	__lzma2_exit(ctx);
+	kfree(ctx);
+}
+
+static void lzma2_exit(struct crypto_tfm *tfm)
+{
+	struct lzma2_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	__lzma2_exit(ctx);
+}
+
+static int __lzma2_compress(const u8 *src, unsigned int slen,
+			    u8 *dst, unsigned int *dlen, struct lzma2_ctx *ctx)
+{
+	struct xz_buf b = {
+		.in		= src,
+		.in_size	= slen,
+		.out		= dst,
+		.out_pos	= 1,
+		.out_size	= *dlen,
+	};
+
+	if (*dlen < 1)
+		return -ENOSPC;
+
+	dst[0] = xz_enc_lzma2_props(ctx->enc);
+	if (xz_enc_lzma2_run(ctx->enc, &b) != XZ_STREAM_END)
+		return -ENOSPC;
+
+	*dlen = b.out_pos;
+	return 0;
+}
+
+static int __lzma2_decompress(const u8 *src, unsigned int slen,
+			      u8 *dst, unsigned int *dlen,
+			      struct lzma2_ctx *ctx)
+{
+	struct xz_buf b = {
+		.in		= src,
+		.in_pos		= 1,
+		.in_size	= slen,
+		.out		= dst,
+		.out_size	= *dlen,
+	};
+
+	if (slen < 1 || xz_dec_lzma2_reset(ctx->dec, src[0]) != XZ_OK)
+		return -EINVAL;
+
+	if (xz_dec_lzma2_run(ctx->dec, &b) != XZ_STREAM_END)
+		return -EINVAL;
+
+	*dlen = b.out_pos;
+	return 0;
+}
+
+static int lzma2_scompress(struct crypto_scomp *tfm, const u8 *src,
+			   unsigned int slen, u8 *dst, unsigned int *dlen,
+			   void *ctx)
+{
+	return __lzma2_compress(src, slen, dst, dlen, ctx);
+}
+
+static int lzma2_compress(struct crypto_tfm *tfm, const u8 *src,
+			  unsigned int slen, u8 *dst, unsigned int *dlen)
+{
+	struct lzma2_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	return __lzma2_compress(src, slen, dst, dlen, ctx);
+}
+
+static int lzma2_sdecompress(struct crypto_scomp *tfm, const u8 *src,
+			     unsigned int slen, u8 *dst, unsigned int *dlen,
+			     void *ctx)
+{
+	return __lzma2_decompress(src, slen, dst, dlen, ctx);
+}
+
+static int lzma2_decompress(struct crypto_tfm *tfm, const u8 *src,
+			    unsigned int slen, u8 *dst, unsigned int *dlen)
+{
+	struct lzma2_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	return __lzma2_decompress(src, slen, dst, dlen, ctx);
+}
+
+static struct crypto_alg alg = {
+	.cra_name		= "lzma2",
+	.cra_flags		= CRYPTO_ALG_TYPE_COMPRESS,
+	.cra_ctxsize		= sizeof(struct lzma2_ctx),
+	.cra_module		= THIS_MODULE,
+	.cra_init		= lzma2_init,
+	.cra_exit		= lzma2_exit,
+	.cra_u			= { .compress = {
+	.coa_compress		= lzma2_compress,
+	.coa_decompress		= lzma2_decompress } }
+};
+
+static struct scomp_alg scomp = {
+	.alloc_ctx		= lzma2_alloc_ctx,
+	.free_ctx		= lzma2_free_ctx,
+	.compress		= lzma2_scompress,
+	.decompress		= lzma2_sdecompress,
+	.base			= {
+		.cra_name	= "lzma2",
+		.cra_driver_name = "lzma2-scomp",
+		.cra_module	 = THIS_MODULE,
+	}
+};
+
+static int __init lzma2_mod_init(void)
+{
+	int ret;
+
+	ret = crypto_register_alg(&alg);
+	if (ret)
+		return ret;
+
+	ret = crypto_register_scomp(&scomp);
+	if (ret) {
+		crypto_unregister_alg(&alg);
+		return ret;
+	}
+
+	return ret;
+}
+
+static void __exit lzma2_mod_fini(void)
+{
+	crypto_unregister_alg(&alg);
+	crypto_unregister_scomp(&scomp);
+}
+
+module_init(lzma2_mod_init);
+module_exit(lzma2_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZMA2 Compression Algorithm");
+MODULE_ALIAS_CRYPTO("lzma2");
@@ -38,6 +38,10 @@
 #include <linux/jiffies.h>
 #include <linux/timex.h>
 #include <linux/interrupt.h>
+#include <linux/kthread.h>
+#include <linux/llist.h>
+#include <linux/sort.h>
+#include <linux/wait.h>
 #include "tcrypt.h"
 
 /*
@@ -67,6 +71,8 @@ static char *alg = NULL;
 static u32 type;
 static u32 mask;
 static int mode;
+static unsigned int threads_nr;
+static unsigned int depth = 8;
 static char *tvmem[TVMEMSIZE];
 
 static char *check[] = {
@@ -992,6 +998,494 @@ static void test_cipher_speed(const char *algo, int enc, unsigned int secs,
 				   false);
 }
 
+/*
+ * Multi-threaded asynchronous speed tests.
+ *
+ * Every kthread keeps @depth requests in flight on a shared transform
+ * until @sec seconds (one second if unset) have elapsed, reissuing each
+ * request from its completion. Out-of-place buffers are used so that a
+ * request can be reissued without being prepared again, which is also why
+ * AEADs are only measured for encryption.
+ */
+#define TCRYPT_MT_SAMPLES	1024
+#define TCRYPT_MT_AAD_SIZE	16
+#define TCRYPT_MT_BUFSIZE	(TVMEMSIZE * PAGE_SIZE)
+
+enum tcrypt_mt_type {
+	TCRYPT_MT_SKCIPHER,
+	TCRYPT_MT_AEAD,
+	TCRYPT_MT_AHASH,
+};
+
+struct tcrypt_mt_test {
+	enum tcrypt_mt_type type;
+	union {
+		struct crypto_skcipher *skcipher;
+		struct crypto_aead *aead;
+		struct crypto_ahash *ahash;
+	} tfm;
+	int enc;
+	unsigned int blen;
+	unsigned int authsize;
+	unsigned long deadline;
+};
+
+struct tcrypt_mt_thread;
+
+struct tcrypt_mt_req {
+	struct tcrypt_mt_thread *thread;
+	struct llist_node node;
+	union {
+		struct skcipher_request *skcipher;
+		struct aead_request *aead;
+		struct ahash_request *ahash;
+	} req;
+	struct scatterlist sg;
+	struct scatterlist sgout;
+	char *buf;
+	char *outbuf;
+	char iv[MAX_IVLEN];
+	char result[MAX_DIGEST_SIZE];
+	u64 start;
+	u64 end;
+	int err;
+};
+
+struct tcrypt_mt_thread {
+	struct tcrypt_mt_test *test;
+	struct task_struct *task;
+	struct tcrypt_mt_req *reqs;
+	struct llist_head done;
+	wait_queue_head_t wait;
+	struct completion exited;
+	unsigned int inflight;
+	u64 ops;
+	u64 *samples;
+	unsigned int nr_samples;
+	int err;
+};
+
+static void tcrypt_mt_done(struct tcrypt_mt_req *r, int err)
+{
+	struct tcrypt_mt_thread *t = r->thread;
+
+	r->end = ktime_get_ns();
+	r->err = err;
+	llist_add(&r->node, &t->done);
+	wake_up(&t->wait);
+}
+
+static void tcrypt_mt_complete(struct crypto_async_request *req, int err)
+{
+	if (err == -EINPROGRESS)
+		return;
+
+	tcrypt_mt_done(req->data, err);
+}
+
+static void tcrypt_mt_issue(struct tcrypt_mt_req *r)
+{
+	struct tcrypt_mt_test *test = r->thread->test;
+	int ret;
+
+	r->thread->inflight++;
+	r->start = ktime_get_ns();
+
+	switch (test->type) {
+	case TCRYPT_MT_SKCIPHER:
+		if (test->enc == ENCRYPT)
+			ret = crypto_skcipher_encrypt(r->req.skcipher);
+		else
+			ret = crypto_skcipher_decrypt(r->req.skcipher);
+		break;
+	case TCRYPT_MT_AEAD:
+		ret = crypto_aead_encrypt(r->req.aead);
+		break;
+	case TCRYPT_MT_AHASH:
+	default:
+		ret = crypto_ahash_digest(r->req.ahash);
+		break;
+	}
+
+	/* The callback is only invoked for requests that went async */
+	if (ret != -EINPROGRESS && ret != -EBUSY)
+		tcrypt_mt_done(r, ret);
+}
+
+static int tcrypt_mt_thread_fn(void *data)
+{
+	struct tcrypt_mt_thread *t = data;
+	struct tcrypt_mt_req *r, *tmp;
+	struct llist_node *done;
+	unsigned int i;
+
+	for (i = 0; i < depth; i++)
+		tcrypt_mt_issue(&t->reqs[i]);
+
+	while (t->inflight) {
+		wait_event(t->wait, !llist_empty(&t->done));
+
+		done = llist_del_all(&t->done);
+		llist_for_each_entry_safe(r, tmp, done, node) {
+			t->inflight--;
+			if (r->err) {
+				t->err = r->err;
+				continue;
+			}
+
+			t->samples[t->nr_samples++ % TCRYPT_MT_SAMPLES] =
+				r->end - r->start;
+			t->ops++;
+
+			if (!t->err && time_before(jiffies, t->test->deadline))
+				tcrypt_mt_issue(r);
+		}
+	}
+
+	complete_and_exit(&t->exited, 0);
+}
+
+static void tcrypt_mt_free_reqs(struct tcrypt_mt_thread *t)
+{
+	struct tcrypt_mt_req *r;
+	unsigned int i;
+
+	kfree(t->samples);
+	if (!t->reqs)
+		return;
+
+	for (i = 0; i < depth; i++) {
+		r = &t->reqs[i];
+
+		switch (t->test->type) {
+		case TCRYPT_MT_SKCIPHER:
+			skcipher_request_free(r->req.skcipher);
+			break;
+		case TCRYPT_MT_AEAD:
+			aead_request_free(r->req.aead);
+			break;
+		case TCRYPT_MT_AHASH:
+			ahash_request_free(r->req.ahash);
+			break;
+		}
+		kfree(r->buf);
+		kfree(r->outbuf);
+	}
+
+	kfree(t->reqs);
+}
+
+static int tcrypt_mt_alloc_reqs(struct tcrypt_mt_thread *t)
+{
+	struct tcrypt_mt_test *test = t->test;
+	struct tcrypt_mt_req *r;
+	unsigned int i;
+
+	t->samples = kcalloc(TCRYPT_MT_SAMPLES, sizeof(*t->samples),
+			     GFP_KERNEL);
+	t->reqs = kcalloc(depth, sizeof(*t->reqs), GFP_KERNEL);
+	if (!t->samples || !t->reqs)
+		return -ENOMEM;
+
+	for (i = 0; i < depth; i++) {
+		r = &t->reqs[i];
+		r->thread = t;
+
+		r->buf = kmalloc(TCRYPT_MT_BUFSIZE, GFP_KERNEL);
+		r->outbuf = kmalloc(TCRYPT_MT_BUFSIZE, GFP_KERNEL);
+		if (!r->buf || !r->outbuf)
+			return -ENOMEM;
+		memset(r->buf, 0xff, TCRYPT_MT_BUFSIZE);
+		memset(r->iv, 0xff, MAX_IVLEN);
+
+		switch (test->type) {
+		case TCRYPT_MT_SKCIPHER:
+			r->req.skcipher = skcipher_request_alloc(
+					test->tfm.skcipher, GFP_KERNEL);
+			if (!r->req.skcipher)
+				return -ENOMEM;
+			skcipher_request_set_callback(r->req.skcipher,
+						      CRYPTO_TFM_REQ_MAY_BACKLOG,
+						      tcrypt_mt_complete, r);
+			break;
+		case TCRYPT_MT_AEAD:
+			r->req.aead = aead_request_alloc(test->tfm.aead,
+							 GFP_KERNEL);
+			if (!r->req.aead)
+				return -ENOMEM;
+			aead_request_set_callback(r->req.aead,
+						  CRYPTO_TFM_REQ_MAY_BACKLOG,
+						  tcrypt_mt_complete, r);
+			break;
+		case TCRYPT_MT_AHASH:
+			r->req.ahash = ahash_request_alloc(test->tfm.ahash,
+							   GFP_KERNEL);
+			if (!r->req.ahash)
+				return -ENOMEM;
+			ahash_request_set_callback(r->req.ahash,
+						   CRYPTO_TFM_REQ_MAY_BACKLOG,
+						   tcrypt_mt_complete, r);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static void tcrypt_mt_set_crypt(struct tcrypt_mt_test *test,
+				struct tcrypt_mt_req *r)
+{
+	unsigned int blen = test->blen;
+
+	switch (test->type) {
+	case TCRYPT_MT_SKCIPHER:
+		sg_init_one(&r->sg, r->buf, blen);
+		sg_init_one(&r->sgout, r->outbuf, blen);
+		skcipher_request_set_crypt(r->req.skcipher, &r->sg, &r->sgout,
+					   blen, r->iv);
+		break;
+	case TCRYPT_MT_AEAD:
+		sg_init_one(&r->sg, r->buf, TCRYPT_MT_AAD_SIZE + blen);
+		sg_init_one(&r->sgout, r->outbuf,
+			    TCRYPT_MT_AAD_SIZE + blen + test->authsize);
+		aead_request_set_ad(r->req.aead, TCRYPT_MT_AAD_SIZE);
+		aead_request_set_crypt(r->req.aead, &r->sg, &r->sgout,
+				       blen, r->iv);
+		break;
+	case TCRYPT_MT_AHASH:
+		sg_init_one(&r->sg, r->buf, blen);
+		ahash_request_set_crypt(r->req.ahash, &r->sg, r->result,
+					blen);
+		break;
+	}
+}
+
+static int tcrypt_mt_cmp(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int tcrypt_mt_run(struct tcrypt_mt_test *test,
+			 struct tcrypt_mt_thread *threads,
+			 unsigned int nthreads, unsigned int secs)
+{
+	unsigned int i, j, n, nr_samples = 0;
+	u64 start, elapsed, ops = 0;
+	u64 *samples;
+	int cpu = -1;
+	int ret = 0;
+
+	for (i = 0; i < nthreads; i++) {
+		struct tcrypt_mt_thread *t = &threads[i];
+
+		for (j = 0; j < depth; j++)
+			tcrypt_mt_set_crypt(test, &t->reqs[j]);
+
+		init_llist_head(&t->done);
+		init_waitqueue_head(&t->wait);
+		init_completion(&t->exited);
+		t->inflight = 0;
+		t->ops = 0;
+		t->nr_samples = 0;
+		t->err = 0;
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+
+		t->task = kthread_create(tcrypt_mt_thread_fn, t,
+					 "tcrypt/%u", i);
+		if (IS_ERR(t->task)) {
+			ret = PTR_ERR(t->task);
+			nthreads = i;
+			break;
+		}
+		kthread_bind(t->task, cpu);
+	}
+
+	test->deadline = jiffies + (secs ?: 1) * HZ;
+	start = ktime_get_ns();
+
+	for (i = 0; i < nthreads; i++)
+		wake_up_process(threads[i].task);
+	for (i = 0; i < nthreads; i++)
+		wait_for_completion(&threads[i].exited);
+
+	elapsed = ktime_get_ns() - start;
+
+	if (ret)
+		return ret;
+
+	for (i = 0; i < nthreads; i++) {
+		if (threads[i].err)
+			return threads[i].err;
+		ops += threads[i].ops;
+		nr_samples += min_t(unsigned int, threads[i].nr_samples,
+				    TCRYPT_MT_SAMPLES);
+	}
+
+	if (!nr_samples)
+		return -EIO;
+
+	samples = kmalloc_array(nr_samples, sizeof(*samples), GFP_KERNEL);
+	if (!samples)
+		return -ENOMEM;
+
+	for (i = 0, n = 0; i < nthreads; i++) {
+		j = min_t(unsigned int, threads[i].nr_samples,
+			  TCRYPT_MT_SAMPLES);
+		memcpy(samples + n, threads[i].samples, j * sizeof(*samples));
+		n += j;
+	}
+	sort(samples, nr_samples, sizeof(*samples), tcrypt_mt_cmp, NULL);
+
+	pr_cont("%llu ops/s, %llu bytes/s, latency p50 %llu p90 %llu p99 %llu max %llu ns\n",
+		div64_u64(ops * NSEC_PER_SEC, elapsed),
+		div64_u64(ops * NSEC_PER_SEC, elapsed) * test->blen,
+		samples[nr_samples * 50 / 100],
+		samples[nr_samples * 90 / 100],
+		samples[nr_samples * 99 / 100],
+		samples[nr_samples - 1]);
+
+	kfree(samples);
+	return 0;
+}
+
+static void test_mt_speed(enum tcrypt_mt_type type, const char *algo,
+			  int enc, unsigned int secs, u8 *keysize,
+			  unsigned int authsize, u32 *sizes)
+{
+	struct tcrypt_mt_thread *threads;
+	struct tcrypt_mt_test test = {
+		.type = type,
+		.enc = enc,
+		.authsize = authsize,
+	};
+	unsigned int i, nthreads;
+	const char *driver = NULL;
+	u8 nokey[] = { 0, 0 };
+	u32 *b_size;
+	int ret = 0;
+
+	nthreads = threads_nr ?: num_online_cpus();
+	if (!depth) {
+		pr_err("depth must be at least 1\n");
+		return;
+	}
+
+	switch (type) {
+	case TCRYPT_MT_SKCIPHER:
+		test.tfm.skcipher = crypto_alloc_skcipher(algo, 0, 0);
+		ret = PTR_ERR_OR_ZERO(test.tfm.skcipher);
+		if (!ret)
+			driver = get_driver_name(crypto_skcipher,
+						 test.tfm.skcipher);
+		break;
+	case TCRYPT_MT_AEAD:
+		test.tfm.aead = crypto_alloc_aead(algo, 0, 0);
+		ret = PTR_ERR_OR_ZERO(test.tfm.aead);
+		if (!ret) {
+			driver = get_driver_name(crypto_aead, test.tfm.aead);
+			ret = crypto_aead_setauthsize(test.tfm.aead, authsize);
+		}
+		break;
+	case TCRYPT_MT_AHASH:
+		test.tfm.ahash = crypto_alloc_ahash(algo, 0, 0);
+		ret = PTR_ERR_OR_ZERO(test.tfm.ahash);
+		if (!ret)
+			driver = get_driver_name(crypto_ahash, test.tfm.ahash);
+		keysize = nokey;
+		break;
+	}
+
+	if (ret) {
+		pr_err("failed to load transform for %s: %d\n", algo, ret);
+		return;
+	}
+
+	pr_info("\ntesting speed of multi-threaded %s (%s) %s, %u threads, %u requests in flight each\n",
+		algo, driver, type == TCRYPT_MT_AHASH ? "digest" :
+		enc == ENCRYPT ? "encryption" : "decryption",
+		nthreads, depth);
+
+	threads = kcalloc(nthreads, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		goto out_free_tfm;
+
+	for (i = 0; i < nthreads; i++) {
+		threads[i].test = &test;
+		if (tcrypt_mt_alloc_reqs(&threads[i])) {
+			pr_err("failed to allocate requests for %s\n", algo);
+			goto out_free_reqs;
+		}
+	}
+
+	i = 0;
+	do {
+		switch (type) {
+		case TCRYPT_MT_SKCIPHER:
+			crypto_skcipher_clear_flags(test.tfm.skcipher, ~0);
+			ret = crypto_skcipher_setkey(test.tfm.skcipher,
+						     tvmem[0], *keysize);
+			break;
+		case TCRYPT_MT_AEAD:
+			crypto_aead_clear_flags(test.tfm.aead, ~0);
+			ret = crypto_aead_setkey(test.tfm.aead, tvmem[0],
+						 *keysize);
+			break;
+		case TCRYPT_MT_AHASH:
+			break;
+		}
+		if (ret) {
+			pr_err("setkey() failed for %s: %d\n", algo, ret);
+			goto out_free_reqs;
+		}
+
+		for (b_size = sizes; *b_size; b_size++, i++) {
+			if (*b_size + TCRYPT_MT_AAD_SIZE + authsize >
+			    TCRYPT_MT_BUFSIZE) {
+				pr_err("template (%u) too big for buffer (%lu)\n",
+				       *b_size, TCRYPT_MT_BUFSIZE);
+				goto out_free_reqs;
+			}
+
+			if (type == TCRYPT_MT_AHASH)
+				pr_info("test %u (%d byte blocks): ", i,
+					*b_size);
+			else
+				pr_info("test %u (%d bit key, %d byte blocks): ",
+					i, *keysize * 8, *b_size);
+
+			test.blen = *b_size;
+			ret = tcrypt_mt_run(&test, threads, nthreads, secs);
+			if (ret) {
+				pr_err("%s() failed: %d\n", algo, ret);
+				goto out_free_reqs;
+			}
+		}
+		keysize++;
+	} while (*keysize);
+
+out_free_reqs:
+	for (i = 0; i < nthreads; i++)
+		tcrypt_mt_free_reqs(&threads[i]);
+	kfree(threads);
+out_free_tfm:
+	switch (type) {
+	case TCRYPT_MT_SKCIPHER:
+		crypto_free_skcipher(test.tfm.skcipher);
+		break;
+	case TCRYPT_MT_AEAD:
+		crypto_free_aead(test.tfm.aead);
+		break;
+	case TCRYPT_MT_AHASH:
+		crypto_free_ahash(test.tfm.ahash);
+		break;
+	}
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -2035,6 +2529,43 @@ static int do_test(const char *alg, u32 type, u32 mask, int m)
 				   speed_template_8_32);
 		break;
 
+	case 600:
+		test_mt_speed(TCRYPT_MT_SKCIPHER, "cbc(aes)", ENCRYPT, sec,
+			      speed_template_16_24_32, 0, block_sizes);
+		test_mt_speed(TCRYPT_MT_SKCIPHER, "cbc(aes)", DECRYPT, sec,
+			      speed_template_16_24_32, 0, block_sizes);
+		test_mt_speed(TCRYPT_MT_SKCIPHER, "ctr(aes)", ENCRYPT, sec,
+			      speed_template_16_24_32, 0, block_sizes);
+		test_mt_speed(TCRYPT_MT_SKCIPHER, "xts(aes)", ENCRYPT, sec,
+			      speed_template_32_48_64, 0, block_sizes);
+		test_mt_speed(TCRYPT_MT_SKCIPHER, "xts(aes)", DECRYPT, sec,
+			      speed_template_32_48_64, 0, block_sizes);
+		break;
+
+	case 601:
+		test_mt_speed(TCRYPT_MT_AEAD, "gcm(aes)", ENCRYPT, sec,
+			      speed_template_16_24_32, 16, aead_sizes);
+		test_mt_speed(TCRYPT_MT_AEAD, "rfc4106(gcm(aes))", ENCRYPT, sec,
+			      aead_speed_template_20, 16, aead_sizes);
+		test_mt_speed(TCRYPT_MT_AEAD, "rfc7539esp(chacha20,poly1305)",
+			      ENCRYPT, sec, aead_speed_template_36, 16,
+			      aead_sizes);
+		break;
+
+	case 602:
+		if (alg) {
+			test_mt_speed(TCRYPT_MT_AHASH, alg, ENCRYPT, sec,
+				      NULL, 0, block_sizes);
+			break;
+		}
+		test_mt_speed(TCRYPT_MT_AHASH, "sha1", ENCRYPT, sec,
+			      NULL, 0, block_sizes);
+		test_mt_speed(TCRYPT_MT_AHASH, "sha256", ENCRYPT, sec,
+			      NULL, 0, block_sizes);
+		test_mt_speed(TCRYPT_MT_AHASH, "sha512", ENCRYPT, sec,
+			      NULL, 0, block_sizes);
+		break;
+
 	case 1000:
 		test_available();
 		break;
@@ -2096,6 +2627,12 @@ module_param(mode, int, 0);
 module_param(sec, uint, 0);
 MODULE_PARM_DESC(sec, "Length in seconds of speed tests "
 		      "(defaults to zero which uses CPU cycles instead)");
+module_param_named(threads, threads_nr, uint, 0);
+MODULE_PARM_DESC(threads, "Number of kthreads for multi-threaded speed tests "
+			  "(defaults to zero which uses one per online CPU)");
+module_param(depth, uint, 0);
+MODULE_PARM_DESC(depth, "Requests in flight per kthread for multi-threaded "
+			"speed tests");
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Quick & dirty crypto testing module");
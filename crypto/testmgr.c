@@ -3268,6 +3268,14 @@ static const struct alg_test_desc alg_test_descs[] = {
 				.decomp = __VECS(lz4hc_decomp_tv_template)
 			}
 		}
+	}, {
+		.alg = "lzma2",
+		.test = alg_test_comp,
+		.suite = {
+			.comp = {
+				.decomp = __VECS(lzma2_decomp_tv_template)
+			}
+		}
 	}, {
 		.alg = "lzo",
 		.test = alg_test_comp,
@@ -34631,4 +34631,35 @@ static const struct comp_testvec lz4hc_decomp_tv_template[] = {
 	},
 };
 
+/*
+ * LZMA2 test vectors. The output of the compressor depends on the preset,
+ * so only decompression is checked against a fixed vector.
+ */
+static const struct comp_testvec lzma2_decomp_tv_template[] = {
+	{
+		.inlen	= 190,
+		.outlen	= 252,
+		.input	= "\x0a\xe0\x00\xfb\x00\xb5\x5d\x00\x26\x16\x85\xbc\x46"
+			  "\xa5\x01\x90\xe8\xcb\x4f\x1c\x3b\xb4\x4a\xc4\x30\x78"
+			  "\x3c\x24\xea\xf2\xed\xe0\xbd\x4b\xec\x75\xd2\x0b\x3e"
+			  "\xf6\xc4\x4f\xd8\x11\xdc\x16\xbc\x30\x05\xbc\x84\x38"
+			  "\x5e\x47\x23\xd7\x8e\x05\x47\x38\x1e\xd8\x28\xbe\xf4"
+			  "\x81\x11\xb1\x87\xab\x76\xe6\xae\x6d\xcb\x7e\xb9\x5e"
+			  "\x8f\x59\x44\x89\xc6\xa0\xed\x7f\x43\x47\x70\x1d\x5f"
+			  "\x9b\x4d\x7b\x38\x14\x43\x93\xd8\xd5\x1a\x68\xa1\x10"
+			  "\x3c\x2e\x89\x8c\x36\xb8\x4d\x00\x49\x46\xba\x5c\xf7"
+			  "\x69\x5b\xbe\x9d\x74\xe3\x3b\xdc\xd5\x8b\xc7\x13\x44"
+			  "\xf8\x9b\x72\xe6\x6b\x2d\xf3\xcf\x7e\x96\xf3\xc2\x6b"
+			  "\x33\x67\x05\x3e\x37\xc8\x56\xca\xbf\xa7\x85\xdf\xaa"
+			  "\x3f\x31\xb3\x58\x9b\x92\xf0\x38\x34\xa9\xa6\xc4\x21"
+			  "\x77\xbf\x0c\xb0\xdc\x35\xee\x37\xe6\x71\xda\x30\xae"
+			  "\x31\x40\x33\xb7\x41\xff\xee\x00",
+		.output	= "LZMA2 is the compression format used by xz. It pairs "
+			  "an LZ77 style dictionary coder with an adaptive range "
+			  "coder, giving a better compression ratio than LZO, LZ4 "
+			  "or deflate at the cost of compression speed. LZMA2 "
+			  "decompression is still reasonably fast.",
+	},
+};
+
 #endif	/* _CRYPTO_TESTMGR_H */
@@ -25,6 +25,7 @@
 #include <linux/list.h>
 #include <linux/fs.h>
 #include <linux/async.h>
+#include <linux/initrd.h>
 #include <linux/pm.h>
 #include <linux/suspend.h>
 #include <linux/syscore_ops.h>
@@ -430,6 +431,8 @@ fw_get_filesystem_firmware(struct device *device, struct firmware_buf *buf)
 		msize = buf->allocated_size;
 	}
 
+	wait_for_initramfs();
+
 	path = __getname();
 	if (!path)
 		return -ENOMEM;
@@ -15,6 +15,8 @@
 #include <linux/sched.h>
 #include <linux/cpu.h>
 #include <linux/crypto.h>
+#include <linux/module.h>
+#include <crypto/acompress.h>
 
 #include "zcomp.h"
 
@@ -31,10 +33,18 @@ static const char * const backends[] = {
 #endif
 #if IS_ENABLED(CONFIG_CRYPTO_842)
 	"842",
+#endif
+#if IS_ENABLED(CONFIG_CRYPTO_LZMA2)
+	"lzma2",
 #endif
 	NULL
 };
 
+static unsigned int max_async_reqs = 64;
+module_param(max_async_reqs, uint, 0444);
+MODULE_PARM_DESC(max_async_reqs,
+	"Max in-flight requests per device for asynchronous compressors");
+
 static void zcomp_strm_free(struct zcomp_strm *zstrm)
 {
 	if (!IS_ERR_OR_NULL(zstrm->tfm))
@@ -81,9 +91,11 @@ bool zcomp_available_algorithm(const char *comp)
 	 * so make sure you don't supply a string containing
 	 * one.
 	 * This also means that we permit zcomp initialisation
-	 * with any compressing algorithm known to crypto api.
+	 * with any compressing algorithm known to crypto api,
+	 * including acomp-only (e.g. hardware offload) ones.
 	 */
-	return crypto_has_comp(comp, 0, 0) == 1;
+	return crypto_has_comp(comp, 0, 0) == 1 ||
+		crypto_has_acomp(comp, 0, 0) == 1;
 }
 
 /* show available compressors */
@@ -108,7 +120,8 @@ ssize_t zcomp_available_show(const char *comp, char *buf)
 	 * Out-of-tree module known to crypto api or a missing
 	 * entry in `backends'.
 	 */
-	if (!known_algorithm && crypto_has_comp(comp, 0, 0) == 1)
+	if (!known_algorithm && (crypto_has_comp(comp, 0, 0) == 1 ||
+				 crypto_has_acomp(comp, 0, 0) == 1))
 		sz += scnprintf(buf + sz, PAGE_SIZE - sz - 2,
 				"[%s] ", comp);
 
@@ -160,6 +173,171 @@ int zcomp_decompress(struct zcomp_strm *zstrm,
 			dst, &dst_len);
 }
 
+static void zcomp_acomp_done(struct crypto_async_request *base, int err)
+{
+	struct zcomp_areq *areq = base->data;
+
+	/* a backlogged request has been accepted by the driver */
+	if (err == -EINPROGRESS)
+		return;
+
+	areq->err = err;
+	areq->dst_len = areq->req->dlen;
+	if (areq->done)
+		queue_work(areq->comp->wq, &areq->work);
+	else
+		complete(&areq->wait);
+}
+
+static void zcomp_areq_work(struct work_struct *work)
+{
+	struct zcomp_areq *areq = container_of(work, struct zcomp_areq, work);
+
+	areq->done(areq);
+}
+
+static void zcomp_areq_free(struct zcomp_areq *areq)
+{
+	if (areq->req)
+		acomp_request_free(areq->req);
+	free_pages((unsigned long)areq->buffer, 1);
+	kfree(areq);
+}
+
+static struct zcomp_areq *zcomp_areq_alloc(struct zcomp *comp,
+		size_t priv_size)
+{
+	struct zcomp_areq *areq;
+
+	areq = kzalloc(sizeof(*areq) + priv_size, GFP_KERNEL);
+	if (!areq)
+		return NULL;
+
+	areq->comp = comp;
+	areq->req = acomp_request_alloc(comp->acomp);
+	/* same 2 page buffer as zcomp_strm, see zcomp_compress() */
+	areq->buffer = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+	if (!areq->req || !areq->buffer) {
+		zcomp_areq_free(areq);
+		return NULL;
+	}
+	INIT_WORK(&areq->work, zcomp_areq_work);
+	init_completion(&areq->wait);
+	return areq;
+}
+
+static struct zcomp_areq *zcomp_areq_tryget(struct zcomp *comp)
+{
+	struct zcomp_areq *areq = NULL;
+
+	spin_lock(&comp->areq_lock);
+	if (!list_empty(&comp->free_areqs)) {
+		areq = list_first_entry(&comp->free_areqs,
+					struct zcomp_areq, list);
+		list_del(&areq->list);
+		comp->nr_free_areqs--;
+	}
+	spin_unlock(&comp->areq_lock);
+	return areq;
+}
+
+/*
+ * get an idle request, sleeping while max_async_reqs requests
+ * are in flight
+ */
+struct zcomp_areq *zcomp_areq_get(struct zcomp *comp)
+{
+	struct zcomp_areq *areq;
+
+	wait_event(comp->areq_wait, (areq = zcomp_areq_tryget(comp)));
+	return areq;
+}
+
+void zcomp_areq_put(struct zcomp_areq *areq)
+{
+	struct zcomp *comp = areq->comp;
+
+	areq->done = NULL;
+	spin_lock(&comp->areq_lock);
+	list_add(&areq->list, &comp->free_areqs);
+	comp->nr_free_areqs++;
+	spin_unlock(&comp->areq_lock);
+	wake_up(&comp->areq_wait);
+}
+
+static bool zcomp_idle(struct zcomp *comp)
+{
+	bool idle;
+
+	spin_lock(&comp->areq_lock);
+	idle = comp->nr_free_areqs == comp->nr_areqs;
+	spin_unlock(&comp->areq_lock);
+	return idle;
+}
+
+/* wait until all asynchronous requests have completed */
+void zcomp_drain(struct zcomp *comp)
+{
+	if (zcomp_is_async(comp))
+		wait_event(comp->areq_wait, zcomp_idle(comp));
+}
+
+/*
+ * compress one page asynchronously. @done is called from process
+ * context once the result (areq->err, areq->dst_len and areq->buffer)
+ * is available; it must return @areq with zcomp_areq_put().
+ */
+void zcomp_compress_async(struct zcomp_areq *areq, struct page *page,
+		void (*done)(struct zcomp_areq *areq))
+{
+	int ret;
+
+	areq->done = done;
+	sg_init_table(&areq->src, 1);
+	sg_set_page(&areq->src, page, PAGE_SIZE, 0);
+	/* see zcomp_compress() for why the dst buffer is 2 pages */
+	sg_init_one(&areq->dst, areq->buffer, PAGE_SIZE * 2);
+	acomp_request_set_params(areq->req, &areq->src, &areq->dst,
+				 PAGE_SIZE, PAGE_SIZE * 2);
+	acomp_request_set_callback(areq->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				   zcomp_acomp_done, areq);
+
+	ret = crypto_acomp_compress(areq->req);
+	if (ret == -EINPROGRESS || ret == -EBUSY)
+		return;
+
+	/* completed synchronously, the callback won't be called */
+	zcomp_acomp_done(&areq->req->base, ret);
+}
+
+/*
+ * decompress src_len bytes, which the caller has copied to areq->buffer,
+ * into @page and wait for the result
+ */
+int zcomp_decompress_wait(struct zcomp_areq *areq,
+		unsigned int src_len, struct page *page)
+{
+	int ret;
+
+	areq->done = NULL;
+	reinit_completion(&areq->wait);
+	sg_init_one(&areq->src, areq->buffer, src_len);
+	sg_init_table(&areq->dst, 1);
+	sg_set_page(&areq->dst, page, PAGE_SIZE, 0);
+	acomp_request_set_params(areq->req, &areq->src, &areq->dst,
+				 src_len, PAGE_SIZE);
+	acomp_request_set_callback(areq->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
+				   CRYPTO_TFM_REQ_MAY_SLEEP,
+				   zcomp_acomp_done, areq);
+
+	ret = crypto_acomp_decompress(areq->req);
+	if (ret == -EINPROGRESS || ret == -EBUSY) {
+		wait_for_completion(&areq->wait);
+		ret = areq->err;
+	}
+	return ret;
+}
+
 int zcomp_cpu_up_prepare(unsigned int cpu, struct hlist_node *node)
 {
 	struct zcomp *comp = hlist_entry(node, struct zcomp, node);
@@ -207,10 +385,63 @@ static int zcomp_init(struct zcomp *comp)
 	return ret;
 }
 
+static void zcomp_destroy_async(struct zcomp *comp)
+{
+	struct zcomp_areq *areq, *tmp;
+
+	zcomp_drain(comp);
+	list_for_each_entry_safe(areq, tmp, &comp->free_areqs, list)
+		zcomp_areq_free(areq);
+	if (comp->wq)
+		destroy_workqueue(comp->wq);
+	crypto_free_acomp(comp->acomp);
+}
+
+static int zcomp_init_async(struct zcomp *comp, size_t areq_priv_size)
+{
+	struct zcomp_areq *areq;
+	int ret;
+
+	INIT_LIST_HEAD(&comp->free_areqs);
+	spin_lock_init(&comp->areq_lock);
+	init_waitqueue_head(&comp->areq_wait);
+
+	comp->acomp = crypto_alloc_acomp(comp->name, CRYPTO_ALG_ASYNC,
+					 CRYPTO_ALG_ASYNC);
+	if (IS_ERR(comp->acomp)) {
+		ret = PTR_ERR(comp->acomp);
+		comp->acomp = NULL;
+		return ret;
+	}
+
+	/* completions may run zsmalloc allocations on the swap-out path */
+	comp->wq = alloc_workqueue("zcomp", WQ_MEM_RECLAIM | WQ_HIGHPRI, 0);
+	if (!comp->wq)
+		goto cleanup;
+
+	while (comp->nr_areqs < max(max_async_reqs, 1U)) {
+		areq = zcomp_areq_alloc(comp, areq_priv_size);
+		if (!areq)
+			goto cleanup;
+		list_add(&areq->list, &comp->free_areqs);
+		comp->nr_areqs++;
+		comp->nr_free_areqs++;
+	}
+	return 0;
+
+cleanup:
+	zcomp_destroy_async(comp);
+	return -ENOMEM;
+}
+
 void zcomp_destroy(struct zcomp *comp)
 {
-	cpuhp_state_remove_instance(CPUHP_ZCOMP_PREPARE, &comp->node);
-	free_percpu(comp->stream);
+	if (zcomp_is_async(comp)) {
+		zcomp_destroy_async(comp);
+	} else {
+		cpuhp_state_remove_instance(CPUHP_ZCOMP_PREPARE, &comp->node);
+		free_percpu(comp->stream);
+	}
 	kfree(comp);
 }
 
@@ -221,8 +452,11 @@ void zcomp_destroy(struct zcomp *comp)
  * if requested algorithm is not supported, ERR_PTR(-ENOMEM) in
  * case of allocation error, or any other error potentially
  * returned by zcomp_init().
+ *
+ * asynchronous algorithms get a pool of requests instead of per-CPU
+ * streams, each with @areq_priv_size bytes of caller private data.
  */
-struct zcomp *zcomp_create(const char *compress)
+struct zcomp *zcomp_create(const char *compress, size_t areq_priv_size)
 {
 	struct zcomp *comp;
 	int error;
@@ -235,7 +469,10 @@ struct zcomp *zcomp_create(const char *compress)
 		return ERR_PTR(-ENOMEM);
 
 	comp->name = compress;
-	error = zcomp_init(comp);
+	if (crypto_has_acomp(compress, CRYPTO_ALG_ASYNC, CRYPTO_ALG_ASYNC))
+		error = zcomp_init_async(comp, areq_priv_size);
+	else
+		error = zcomp_init(comp);
 	if (error) {
 		kfree(comp);
 		return ERR_PTR(error);
@@ -10,17 +10,53 @@
 #ifndef _ZCOMP_H_
 #define _ZCOMP_H_
 
+#include <linux/completion.h>
+#include <linux/scatterlist.h>
+#include <linux/workqueue.h>
+
 struct zcomp_strm {
 	/* compression/decompression buffer */
 	void *buffer;
 	struct crypto_comp *tfm;
 };
 
+/*
+ * asynchronous (de)compression request, used instead of the per-CPU
+ * streams when the backend is an asynchronous acomp implementation,
+ * e.g. a hardware compression engine
+ */
+struct zcomp_areq {
+	struct zcomp *comp;
+	struct acomp_req *req;
+	struct scatterlist src;
+	struct scatterlist dst;
+	/* compression/decompression buffer, same size as zcomp_strm's */
+	void *buffer;
+	unsigned int dst_len;
+	int err;
+	/* called from process context once an async compression is done */
+	void (*done)(struct zcomp_areq *areq);
+	struct work_struct work;
+	struct completion wait;
+	struct list_head list;
+	/* followed by the caller's private area, see zcomp_areq_priv() */
+};
+
 /* dynamic per-device compression frontend */
 struct zcomp {
 	struct zcomp_strm * __percpu *stream;
 	const char *name;
 	struct hlist_node node;
+
+	/* asynchronous backend, NULL for synchronous algorithms */
+	struct crypto_acomp *acomp;
+	struct workqueue_struct *wq;
+	/* preallocated requests, bounding the number in flight */
+	struct list_head free_areqs;
+	spinlock_t areq_lock;
+	wait_queue_head_t areq_wait;
+	unsigned int nr_areqs;
+	unsigned int nr_free_areqs;
 };
 
 int zcomp_cpu_up_prepare(unsigned int cpu, struct hlist_node *node);
@@ -28,7 +64,7 @@ int zcomp_cpu_dead(unsigned int cpu, struct hlist_node *node);
 ssize_t zcomp_available_show(const char *comp, char *buf);
 bool zcomp_available_algorithm(const char *comp);
 
-struct zcomp *zcomp_create(const char *comp);
+struct zcomp *zcomp_create(const char *comp, size_t areq_priv_size);
 void zcomp_destroy(struct zcomp *comp);
 
 struct zcomp_strm *zcomp_stream_get(struct zcomp *comp);
@@ -41,4 +77,23 @@ int zcomp_decompress(struct zcomp_strm *zstrm,
 		const void *src, unsigned int src_len, void *dst);
 
 bool zcomp_set_max_streams(struct zcomp *comp, int num_strm);
+
+static inline bool zcomp_is_async(struct zcomp *comp)
+{
+	return comp->acomp != NULL;
+}
+
+static inline void *zcomp_areq_priv(struct zcomp_areq *areq)
+{
+	return areq + 1;
+}
+
+struct zcomp_areq *zcomp_areq_get(struct zcomp *comp);
+void zcomp_areq_put(struct zcomp_areq *areq);
+void zcomp_drain(struct zcomp *comp);
+
+void zcomp_compress_async(struct zcomp_areq *areq, struct page *page,
+		void (*done)(struct zcomp_areq *areq));
+int zcomp_decompress_wait(struct zcomp_areq *areq,
+		unsigned int src_len, struct page *page);
 #endif /* _ZCOMP_H_ */
@@ -546,10 +546,14 @@ static int zram_decompress_page(struct zram *zram, struct page *page, u32 index)
 	unsigned long handle;
 	unsigned int size;
 	void *src, *dst;
+	struct zcomp_areq *areq = NULL;
 
 	if (zram_same_page_read(zram, index, page, 0, PAGE_SIZE))
 		return 0;
 
+	if (zcomp_is_async(zram->comp))
+		areq = zcomp_areq_get(zram->comp);
+
 	zram_slot_lock(zram, index);
 	handle = zram_get_handle(zram, index);
 	size = zram_get_obj_size(zram, index);
@@ -560,6 +564,10 @@ static int zram_decompress_page(struct zram *zram, struct page *page, u32 index)
 		memcpy(dst, src, PAGE_SIZE);
 		kunmap_atomic(dst);
 		ret = 0;
+	} else if (areq) {
+		/* the backend may sleep, don't hold the slot lock over it */
+		memcpy(areq->buffer, src, size);
+		ret = 0;
 	} else {
 		struct zcomp_strm *zstrm = zcomp_stream_get(zram->comp);
 
@@ -571,6 +579,12 @@ static int zram_decompress_page(struct zram *zram, struct page *page, u32 index)
 	zs_unmap_object(zram->mem_pool, handle);
 	zram_slot_unlock(zram, index);
 
+	if (areq) {
+		if (size != PAGE_SIZE)
+			ret = zcomp_decompress_wait(areq, size, page);
+		zcomp_areq_put(areq);
+	}
+
 	/* Should NEVER happen. Return bio error if it does. */
 	if (unlikely(ret))
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
@@ -727,13 +741,170 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index)
 	return 0;
 }
 
+/* per-request state of a write in flight, see zram_bvec_write_async() */
+struct zram_async_write {
+	struct zram *zram;
+	struct bio *bio;
+	/* the page being compressed */
+	struct page *page;
+	/* temporary page for partial IO, freed on completion */
+	struct page *tmp_page;
+	u32 index;
+	/* for I/O accounting, which ends when the page is stored */
+	unsigned long start_time;
+};
+
+/*
+ * Only one write to a slot may be in flight to an asynchronous backend,
+ * so that a later write to the same slot - a read-modify-write of a
+ * partial page, a same-filled page or another compression - can't be
+ * based on, or be overwritten by, an older store that has yet to land.
+ */
+static void zram_async_claim_slot(struct zram *zram, u32 index)
+{
+	for (;;) {
+		zram_slot_lock(zram, index);
+		if (!zram_test_flag(zram, index, ZRAM_ASYNC_WRITE)) {
+			zram_set_flag(zram, index, ZRAM_ASYNC_WRITE);
+			zram_slot_unlock(zram, index);
+			return;
+		}
+		zram_slot_unlock(zram, index);
+		wait_event(zram->async_wait,
+			   !zram_test_flag(zram, index, ZRAM_ASYNC_WRITE));
+	}
+}
+
+static void zram_async_release_slot(struct zram *zram, u32 index)
+{
+	zram_slot_lock(zram, index);
+	zram_clear_flag(zram, index, ZRAM_ASYNC_WRITE);
+	zram_slot_unlock(zram, index);
+	wake_up_all(&zram->async_wait);
+}
+
+static void zram_async_write_done(struct zcomp_areq *areq)
+{
+	struct zram_async_write *aw = zcomp_areq_priv(areq);
+	struct zram *zram = aw->zram;
+	struct bio *bio = aw->bio;
+	unsigned long alloced_pages;
+	unsigned long handle;
+	unsigned int comp_len;
+	void *src, *dst;
+	int ret = areq->err;
+
+	if (unlikely(ret)) {
+		pr_err("Compression failed! err=%d\n", ret);
+		goto out;
+	}
+
+	comp_len = areq->dst_len;
+	if (unlikely(comp_len > max_zpage_size))
+		comp_len = PAGE_SIZE;
+
+	/* we run from a workqueue, so there's no stream to put back */
+	handle = zs_malloc(zram->mem_pool, comp_len,
+			GFP_NOIO | __GFP_HIGHMEM | __GFP_MOVABLE);
+	if (!handle) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	alloced_pages = zs_get_total_pages(zram->mem_pool);
+	update_used_max(zram, alloced_pages);
+
+	if (zram->limit_pages && alloced_pages > zram->limit_pages) {
+		zs_free(zram->mem_pool, handle);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	dst = zs_map_object(zram->mem_pool, handle, ZS_MM_WO);
+
+	src = areq->buffer;
+	if (comp_len == PAGE_SIZE)
+		src = kmap_atomic(aw->page);
+	memcpy(dst, src, comp_len);
+	if (comp_len == PAGE_SIZE)
+		kunmap_atomic(src);
+
+	zs_unmap_object(zram->mem_pool, handle);
+
+	zram_slot_lock(zram, aw->index);
+	zram_free_page(zram, aw->index);
+	zram_set_handle(zram, aw->index, handle);
+	zram_set_obj_size(zram, aw->index, comp_len);
+	zram_slot_unlock(zram, aw->index);
+
+	/* Update stats */
+	atomic64_add(comp_len, &zram->stats.compr_data_size);
+	atomic64_inc(&zram->stats.pages_stored);
+out:
+	if (unlikely(ret)) {
+		atomic64_inc(&zram->stats.failed_writes);
+		bio->bi_status = BLK_STS_IOERR;
+	}
+	zram_async_release_slot(zram, aw->index);
+	generic_end_io_acct(REQ_OP_WRITE, &zram->disk->part0, aw->start_time);
+	if (aw->tmp_page)
+		__free_page(aw->tmp_page);
+	zcomp_areq_put(areq);
+	bio_endio(bio);
+}
+
+/*
+ * Queue the compression of one full page to an asynchronous backend and
+ * return without waiting for it. The bio is completed once all of its
+ * pages have been stored by zram_async_write_done(). The caller must
+ * have claimed the slot, which is released once the page is stored.
+ * Takes ownership of @tmp_page.
+ *
+ * Returns 1 if the write was queued, in which case the I/O accounting
+ * is also ended by zram_async_write_done(), or 0 if it was completed.
+ */
+static int zram_bvec_write_async(struct zram *zram, struct bio_vec *bvec,
+				u32 index, struct bio *bio,
+				struct page *tmp_page, unsigned long start_time)
+{
+	struct page *page = bvec->bv_page;
+	struct zram_async_write *aw;
+	struct zcomp_areq *areq;
+
+	if (zram_same_page_write(zram, index, page)) {
+		zram_async_release_slot(zram, index);
+		if (tmp_page)
+			__free_page(tmp_page);
+		return 0;
+	}
+
+	areq = zcomp_areq_get(zram->comp);
+	aw = zcomp_areq_priv(areq);
+	aw->zram = zram;
+	aw->bio = bio;
+	aw->page = page;
+	aw->tmp_page = tmp_page;
+	aw->index = index;
+	aw->start_time = start_time;
+
+	bio_inc_remaining(bio);
+	zcomp_compress_async(areq, page, zram_async_write_done);
+	return 1;
+}
+
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
-				u32 index, int offset)
+				u32 index, int offset, struct bio *bio,
+				unsigned long start_time)
 {
 	int ret;
 	struct page *page = NULL;
 	void *src;
 	struct bio_vec vec;
+	bool async = bio && zcomp_is_async(zram->comp);
+
+	/* Wait for any earlier store to this slot before touching it. */
+	if (async)
+		zram_async_claim_slot(zram, index);
 
 	vec = *bvec;
 	if (is_partial_io(bvec)) {
@@ -743,8 +914,10 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 		 * before to write the changes.
 		 */
 		page = alloc_page(GFP_NOIO|__GFP_HIGHMEM);
-		if (!page)
-			return -ENOMEM;
+		if (!page) {
+			ret = -ENOMEM;
+			goto out;
+		}
 
 		ret = zram_decompress_page(zram, page, index);
 		if (ret)
@@ -761,9 +934,15 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 		vec.bv_offset = 0;
 	}
 
+	if (async)
+		return zram_bvec_write_async(zram, &vec, index, bio, page,
+					     start_time);
+
 	ret = __zram_bvec_write(zram, &vec, index);
 out:
-	if (is_partial_io(bvec))
+	if (async)
+		zram_async_release_slot(zram, index);
+	if (page)
 		__free_page(page);
 	return ret;
 }
@@ -806,8 +985,12 @@ static void zram_bio_discard(struct zram *zram, u32 index,
 	}
 }
 
+/*
+ * @bio is the request the bvec belongs to, or NULL for ->rw_page(). It is
+ * needed to complete writes to asynchronous compression backends.
+ */
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
-			int offset, bool is_write)
+			int offset, bool is_write, struct bio *bio)
 {
 	unsigned long start_time = jiffies;
 	int rw_acct = is_write ? REQ_OP_WRITE : REQ_OP_READ;
@@ -822,7 +1005,11 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 		flush_dcache_page(bvec->bv_page);
 	} else {
 		atomic64_inc(&zram->stats.num_writes);
-		ret = zram_bvec_write(zram, bvec, index, offset);
+		ret = zram_bvec_write(zram, bvec, index, offset, bio,
+				      start_time);
+		/* Queued: accounting ends when the page has been stored. */
+		if (ret > 0)
+			return 0;
 	}
 
 	generic_end_io_acct(rw_acct, &zram->disk->part0, start_time);
@@ -866,7 +1053,7 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 			bv.bv_len = min_t(unsigned int, PAGE_SIZE - offset,
 							unwritten);
 			if (zram_bvec_rw(zram, &bv, index, offset,
-					op_is_write(bio_op(bio))) < 0)
+					op_is_write(bio_op(bio)), bio) < 0)
 				goto out;
 
 			bv.bv_offset += bv.bv_len;
@@ -933,6 +1120,16 @@ static int zram_rw_page(struct block_device *bdev, sector_t sector,
 		goto out;
 	}
 
+	/*
+	 * ->rw_page() must finish the write before returning, which would
+	 * serialize the asynchronous backend. Let the caller fall back to
+	 * a bio, so that writes can be in flight concurrently.
+	 */
+	if (is_write && zcomp_is_async(zram->comp)) {
+		err = -EOPNOTSUPP;
+		goto out;
+	}
+
 	index = sector >> SECTORS_PER_PAGE_SHIFT;
 	offset = (sector & (SECTORS_PER_PAGE - 1)) << SECTOR_SHIFT;
 
@@ -940,7 +1137,7 @@ static int zram_rw_page(struct block_device *bdev, sector_t sector,
 	bv.bv_len = PAGE_SIZE;
 	bv.bv_offset = 0;
 
-	err = zram_bvec_rw(zram, &bv, index, offset, is_write);
+	err = zram_bvec_rw(zram, &bv, index, offset, is_write, NULL);
 out:
 	/*
 	 * If I/O fails, just return error(ie, non-zero) without
@@ -977,6 +1174,8 @@ static void zram_reset_device(struct zram *zram)
 	part_stat_set_all(&zram->disk->part0, 0);
 
 	up_write(&zram->init_lock);
+	/* writes to an asynchronous backend may still be in flight */
+	zcomp_drain(comp);
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(zram, disksize);
 	memset(&zram->stats, 0, sizeof(zram->stats));
@@ -1008,7 +1207,8 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_unlock;
 	}
 
-	comp = zcomp_create(zram->compressor);
+	comp = zcomp_create(zram->compressor,
+			sizeof(struct zram_async_write));
 	if (IS_ERR(comp)) {
 		pr_err("Cannot initialise %s compressing backend\n",
 				zram->compressor);
@@ -1146,6 +1346,7 @@ static int zram_add(void)
 	device_id = ret;
 
 	init_rwsem(&zram->init_lock);
+	init_waitqueue_head(&zram->async_wait);
 
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
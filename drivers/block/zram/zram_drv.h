@@ -63,6 +63,7 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_SAME = ZRAM_FLAG_SHIFT,
 	ZRAM_ACCESS,	/* page is now accessed */
+	ZRAM_ASYNC_WRITE,	/* write in flight to an async backend */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -115,5 +116,7 @@ struct zram {
 	 * zram is claimed so open request will be failed
 	 */
 	bool claim; /* Protected by bdev->bd_mutex */
+	/* woken when a slot's ZRAM_ASYNC_WRITE is cleared */
+	wait_queue_head_t async_wait;
 };
 #endif
@@ -28,7 +28,9 @@
 #include <linux/irq.h>
 #include <linux/mm.h>
 #include <linux/pci.h>
+#include <linux/percpu.h>
 #include <linux/scatterlist.h>
+#include <linux/timer.h>
 #include <linux/vmalloc.h>
 
 struct iommu_dma_msi_page {
@@ -42,6 +44,27 @@ enum iommu_dma_cookie_type {
 	IOMMU_DMA_MSI_COOKIE,
 };
 
+/*
+ * Flush queue of unmapped IOVAs whose IOTLB entries may still be live.
+ * Each entry remembers how many domain-wide flushes had been started when
+ * it was queued, and may go back to the allocator once a flush started
+ * after that has finished.
+ */
+#define IOMMU_DMA_FQ_SIZE	256	/* entries per CPU */
+#define IOMMU_DMA_FQ_TIMEOUT	10	/* ms */
+
+struct iommu_dma_fq_entry {
+	unsigned long		iova_pfn;
+	unsigned long		pages;
+	u64			counter;
+};
+
+struct iommu_dma_fq {
+	spinlock_t		lock;
+	unsigned int		head, tail;
+	struct iommu_dma_fq_entry entries[IOMMU_DMA_FQ_SIZE];
+};
+
 struct iommu_dma_cookie {
 	enum iommu_dma_cookie_type	type;
 	union {
@@ -52,6 +75,14 @@ struct iommu_dma_cookie {
 	};
 	struct list_head		msi_page_list;
 	spinlock_t			msi_lock;
+
+	/* Deferred IOTLB invalidation, see DOMAIN_ATTR_DMA_USE_FLUSH_QUEUE */
+	struct iommu_domain		*fq_domain;
+	struct iommu_dma_fq __percpu	*fq;
+	atomic64_t			fq_flush_start_cnt;
+	atomic64_t			fq_flush_finish_cnt;
+	struct timer_list		fq_timer;
+	atomic_t			fq_timer_on;
 };
 
 static inline size_t cookie_msi_granule(struct iommu_dma_cookie *cookie)
@@ -146,6 +177,11 @@ void iommu_put_dma_cookie(struct iommu_domain *domain)
 	if (!cookie)
 		return;
 
+	if (cookie->fq) {
+		del_timer_sync(&cookie->fq_timer);
+		free_percpu(cookie->fq);
+	}
+
 	if (cookie->type == IOMMU_DMA_IOVA_COOKIE && cookie->iovad.granule)
 		put_iova_domain(&cookie->iovad);
 
@@ -253,6 +289,134 @@ static int iova_reserve_iommu_regions(struct device *dev,
 	return ret;
 }
 
+static void iommu_dma_fq_flush_iotlb(struct iommu_dma_cookie *cookie)
+{
+	/*
+	 * Entries stamped with the old start count must not be able to see
+	 * the flush as done before it has really been issued, and nothing may
+	 * see the new finish count before the flush has completed.
+	 */
+	atomic64_inc(&cookie->fq_flush_start_cnt);
+	smp_mb__after_atomic();
+	iommu_flush_tlb_all(cookie->fq_domain);
+	smp_mb__before_atomic();
+	atomic64_inc(&cookie->fq_flush_finish_cnt);
+}
+
+/* Give back every queued IOVA covered by a completed flush */
+static void iommu_dma_fq_ring_free(struct iommu_dma_cookie *cookie,
+		struct iommu_dma_fq *fq)
+{
+	u64 counter = atomic64_read(&cookie->fq_flush_finish_cnt);
+
+	assert_spin_locked(&fq->lock);
+
+	while (fq->head != fq->tail) {
+		struct iommu_dma_fq_entry *entry = &fq->entries[fq->head];
+
+		if (entry->counter >= counter)
+			break;
+
+		free_iova_fast(&cookie->iovad, entry->iova_pfn, entry->pages);
+		fq->head = (fq->head + 1) % IOMMU_DMA_FQ_SIZE;
+	}
+}
+
+static void iommu_dma_fq_timeout(unsigned long data)
+{
+	struct iommu_dma_cookie *cookie = (struct iommu_dma_cookie *)data;
+	unsigned long flags;
+	int cpu;
+
+	atomic_set(&cookie->fq_timer_on, 0);
+	iommu_dma_fq_flush_iotlb(cookie);
+
+	for_each_possible_cpu(cpu) {
+		struct iommu_dma_fq *fq = per_cpu_ptr(cookie->fq, cpu);
+
+		spin_lock_irqsave(&fq->lock, flags);
+		iommu_dma_fq_ring_free(cookie, fq);
+		spin_unlock_irqrestore(&fq->lock, flags);
+	}
+}
+
+static void iommu_dma_fq_add(struct iommu_dma_cookie *cookie,
+		unsigned long iova_pfn, unsigned long pages)
+{
+	struct iommu_dma_fq *fq;
+	struct iommu_dma_fq_entry *entry;
+	unsigned long flags;
+
+	/*
+	 * Order the caller's page table update against the flush counter
+	 * reads below: any flush not yet counted in fq_flush_start_cnt when
+	 * this entry is stamped must observe the unmap.
+	 */
+	smp_mb();
+
+	fq = get_cpu_ptr(cookie->fq);
+	spin_lock_irqsave(&fq->lock, flags);
+
+	/*
+	 * Reclaim anything a flush from another CPU has already covered, and
+	 * only pay for a flush ourselves if that still leaves no room.
+	 */
+	iommu_dma_fq_ring_free(cookie, fq);
+	if ((fq->tail + 1) % IOMMU_DMA_FQ_SIZE == fq->head) {
+		iommu_dma_fq_flush_iotlb(cookie);
+		iommu_dma_fq_ring_free(cookie, fq);
+	}
+
+	entry = &fq->entries[fq->tail];
+	entry->iova_pfn = iova_pfn;
+	entry->pages = pages;
+	entry->counter = atomic64_read(&cookie->fq_flush_start_cnt);
+	fq->tail = (fq->tail + 1) % IOMMU_DMA_FQ_SIZE;
+
+	spin_unlock_irqrestore(&fq->lock, flags);
+	put_cpu_ptr(cookie->fq);
+
+	if (!atomic_read(&cookie->fq_timer_on) &&
+	    !atomic_xchg(&cookie->fq_timer_on, 1))
+		mod_timer(&cookie->fq_timer,
+			  jiffies + msecs_to_jiffies(IOMMU_DMA_FQ_TIMEOUT));
+}
+
+static void iommu_dma_init_fq(struct iommu_domain *domain)
+{
+	struct iommu_dma_cookie *cookie = domain->iova_cookie;
+	int attr, cpu;
+
+	if (iommu_domain_get_attr(domain, DOMAIN_ATTR_DMA_USE_FLUSH_QUEUE,
+				  &attr) || !attr)
+		return;
+
+	/*
+	 * The driver has stopped invalidating on unmap, so from here on we
+	 * have to flush the IOTLB ourselves, one way or another.
+	 */
+	cookie->fq_domain = domain;
+
+	cookie->fq = alloc_percpu(struct iommu_dma_fq);
+	if (!cookie->fq) {
+		pr_warn("flush queue allocation failed, flushing on every unmap\n");
+		return;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct iommu_dma_fq *fq = per_cpu_ptr(cookie->fq, cpu);
+
+		spin_lock_init(&fq->lock);
+		fq->head = fq->tail = 0;
+	}
+
+	atomic64_set(&cookie->fq_flush_start_cnt, 0);
+	atomic64_set(&cookie->fq_flush_finish_cnt, 0);
+	atomic_set(&cookie->fq_timer_on, 0);
+	setup_timer(&cookie->fq_timer, iommu_dma_fq_timeout,
+		    (unsigned long)cookie);
+}
+
 /**
  * iommu_dma_init_domain - Initialise a DMA mapping domain
  * @domain: IOMMU domain previously prepared by iommu_get_dma_cookie()
@@ -320,6 +484,7 @@ int iommu_dma_init_domain(struct iommu_domain *domain, dma_addr_t base,
 	}
 
 	init_iova_domain(iovad, 1UL << order, base_pfn, end_pfn);
+	iommu_dma_init_fq(domain);
 	if (!dev)
 		return 0;
 
@@ -416,6 +581,15 @@ static void __iommu_dma_unmap(struct iommu_domain *domain, dma_addr_t dma_addr,
 	size = iova_align(iovad, size + iova_off);
 
 	WARN_ON(iommu_unmap(domain, dma_addr, size) != size);
+
+	if (cookie->fq) {
+		iommu_dma_fq_add(cookie, iova_pfn(iovad, dma_addr),
+				 size >> iova_shift(iovad));
+		return;
+	}
+
+	if (cookie->fq_domain)
+		iommu_flush_tlb_all(domain);
 	iommu_dma_free_iova(cookie, dma_addr, size);
 }
 
@@ -517,7 +517,7 @@ static int __arm_lpae_unmap(struct arm_lpae_io_pgtable *data,
 			io_pgtable_tlb_sync(iop);
 			ptep = iopte_deref(pte, data);
 			__arm_lpae_free_pgtable(data, lvl + 1, ptep);
-		} else {
+		} else if (!(iop->cfg.quirks & IO_PGTABLE_QUIRK_NON_STRICT)) {
 			io_pgtable_tlb_add_flush(iop, iova, size, size, true);
 		}
 
@@ -546,7 +546,11 @@ static int arm_lpae_unmap(struct io_pgtable_ops *ops, unsigned long iova,
 	int lvl = ARM_LPAE_START_LVL(data);
 
 	unmapped = __arm_lpae_unmap(data, iova, size, lvl, ptep);
-	if (unmapped)
+	/*
+	 * Non-strict mode leaves leaf invalidation to the flush queue, and
+	 * freeing a table has already synced in __arm_lpae_unmap().
+	 */
+	if (unmapped && !(data->iop.cfg.quirks & IO_PGTABLE_QUIRK_NON_STRICT))
 		io_pgtable_tlb_sync(&data->iop);
 
 	return unmapped;
@@ -673,7 +677,8 @@ arm_64_lpae_alloc_pgtable_s1(struct io_pgtable_cfg *cfg, void *cookie)
 	u64 reg;
 	struct arm_lpae_io_pgtable *data;
 
-	if (cfg->quirks & ~IO_PGTABLE_QUIRK_ARM_NS)
+	if (cfg->quirks & ~(IO_PGTABLE_QUIRK_ARM_NS |
+			    IO_PGTABLE_QUIRK_NON_STRICT))
 		return NULL;
 
 	data = arm_lpae_alloc_pgtable(cfg);
@@ -762,7 +767,7 @@ arm_64_lpae_alloc_pgtable_s2(struct io_pgtable_cfg *cfg, void *cookie)
 	struct arm_lpae_io_pgtable *data;
 
 	/* The NS quirk doesn't apply at stage 2 */
-	if (cfg->quirks)
+	if (cfg->quirks & ~IO_PGTABLE_QUIRK_NON_STRICT)
 		return NULL;
 
 	data = arm_lpae_alloc_pgtable(cfg);
@@ -287,13 +287,13 @@ static int mmc_dbg_card_status_get(void *data, u64 *val)
 	u32		status;
 	int		ret;
 
-	mmc_get_card(card);
+	mmc_get_card(card, NULL);
 
 	ret = mmc_send_status(data, &status);
 	if (!ret)
 		*val = status;
 
-	mmc_put_card(card);
+	mmc_put_card(card, NULL);
 
 	return ret;
 }
@@ -314,9 +314,9 @@ static int mmc_ext_csd_open(struct inode *inode, struct file *filp)
 	if (!buf)
 		return -ENOMEM;
 
-	mmc_get_card(card);
+	mmc_get_card(card, NULL);
 	err = mmc_get_ext_csd(card, &ext_csd);
-	mmc_put_card(card);
+	mmc_put_card(card, NULL);
 	if (err)
 		goto out_free;
 
@@ -111,6 +111,16 @@ void mmc_retune_hold(struct mmc_host *host)
 	host->hold_retune += 1;
 }
 
+/*
+ * Like mmc_retune_hold(), but do not allow a pending re-tune to run at the
+ * next request either, e.g. while the CQE is being recovered.
+ */
+void mmc_retune_hold_now(struct mmc_host *host)
+{
+	host->retune_now = 0;
+	host->hold_retune += 1;
+}
+
 void mmc_retune_release(struct mmc_host *host)
 {
 	if (host->hold_retune)
@@ -3,6 +3,8 @@
 
 #include <linux/types.h>
 #include <linux/blkdev.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 #include <linux/blk-mq.h>
 #include <linux/mmc/core.h>
 #include <linux/mmc/host.h>
@@ -23,6 +25,27 @@ struct task_struct;
 struct mmc_blk_data;
 struct mmc_blk_ioc_data;
 
+enum mmc_issued {
+	MMC_REQ_STARTED,
+	MMC_REQ_BUSY,
+	MMC_REQ_FAILED_TO_START,
+	MMC_REQ_FINISHED,
+};
+
+/**
+ * enum mmc_issue_type - how a request is issued on a CQE queue
+ * @MMC_ISSUE_SYNC: issued and completed in the queue's own context, with the
+ *	CQE idle
+ * @MMC_ISSUE_DCMD: issued to the CQE as a direct command
+ * @MMC_ISSUE_ASYNC: issued to the CQE as a data transfer task
+ */
+enum mmc_issue_type {
+	MMC_ISSUE_SYNC,
+	MMC_ISSUE_DCMD,
+	MMC_ISSUE_ASYNC,
+	MMC_ISSUE_MAX,
+};
+
 struct mmc_blk_request {
 	struct mmc_request	mrq;
 	struct mmc_command	sbc;
@@ -53,6 +76,7 @@ struct mmc_queue_req {
 	int			drv_op_result;
 	struct mmc_blk_ioc_data	**idata;
 	unsigned int		ioc_count;
+	int			retries;
 };
 
 struct mmc_queue {
@@ -70,6 +94,22 @@ struct mmc_queue {
 	 * associated mmc_queue_req data.
 	 */
 	int			qcnt;
+
+	/*
+	 * The following are only used when the host has a command queue
+	 * engine (CQE) enabled, in which case the queue is a blk-mq queue
+	 * and the host stays claimed by @ctx while any request is in flight.
+	 */
+	struct blk_mq_tag_set	tag_set;
+	struct mmc_ctx		ctx;
+	bool			use_cqe;
+	bool			busy;
+#define MMC_CQE_DCMD_BUSY	BIT(0)
+	unsigned int		cqe_busy;
+	bool			recovery_needed;
+	bool			in_recovery;
+	int			in_flight[MMC_ISSUE_MAX];
+	struct work_struct	recovery_work;
 };
 
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *,
@@ -85,4 +125,22 @@ extern void mmc_queue_bounce_post(struct mmc_queue_req *);
 
 extern int mmc_access_rpmb(struct mmc_queue *);
 
+extern enum mmc_issue_type mmc_issue_type(struct mmc_queue *mq,
+					  struct request *req);
+extern void mmc_cqe_check_busy(struct mmc_queue *mq);
+extern void mmc_cqe_recovery_notifier(struct mmc_queue *mq);
+
+static inline int mmc_tot_in_flight(struct mmc_queue *mq)
+{
+	return mq->in_flight[MMC_ISSUE_SYNC] +
+	       mq->in_flight[MMC_ISSUE_DCMD] +
+	       mq->in_flight[MMC_ISSUE_ASYNC];
+}
+
+static inline int mmc_cqe_qcnt(struct mmc_queue *mq)
+{
+	return mq->in_flight[MMC_ISSUE_DCMD] +
+	       mq->in_flight[MMC_ISSUE_ASYNC];
+}
+
 #endif
@@ -65,6 +65,8 @@
 #define OMAP_HSMMC_ISE		0x0138
 #define OMAP_HSMMC_AC12		0x013C
 #define OMAP_HSMMC_CAPA		0x0140
+#define OMAP_HSMMC_ADMAES	0x0154
+#define OMAP_HSMMC_ADMASAL	0x0158
 
 #define VS18			(1 << 26)
 #define VS30			(1 << 25)
@@ -107,6 +109,10 @@
 #define SRC			(1 << 25)
 #define SRD			(1 << 26)
 #define SOFTRESET		(1 << 1)
+#define DMA_MNS			(1 << 20)
+#define DMA_SELECT		(2 << 3)
+#define DMA_MASK		(3 << 3)
+#define CAPA_ADMA_SUPPORT	(1 << 19)
 
 /* PSTATE */
 #define DLEV_DAT(x)		(1 << (20 + (x)))
@@ -126,10 +132,11 @@
 #define DCRC_EN			(1 << 21)
 #define DEB_EN			(1 << 22)
 #define ACE_EN			(1 << 24)
+#define ADMAE_EN		(1 << 25)
 #define CERR_EN			(1 << 28)
 #define BADA_EN			(1 << 29)
 
-#define INT_EN_MASK (BADA_EN | CERR_EN | ACE_EN | DEB_EN | DCRC_EN |\
+#define INT_EN_MASK (BADA_EN | CERR_EN | ADMAE_EN | ACE_EN | DEB_EN | DCRC_EN |\
 		DTO_EN | CIE_EN | CEB_EN | CCRC_EN | CTO_EN | \
 		BRR_EN | BWR_EN | TC_EN | CC_EN)
 
@@ -140,6 +147,19 @@
 #define ACTO	(1 << 1)
 #define ACNE	(1 << 0)
 
+/* ADMA2 descriptor attributes */
+#define ADMA_DESC_ATTR_VALID	(1 << 0)
+#define ADMA_DESC_ATTR_END	(1 << 1)
+#define ADMA_DESC_ATTR_INT	(1 << 2)
+#define ADMA_DESC_ATTR_ACT2	(1 << 5)
+#define ADMA_DESC_TRANSFER_DATA	ADMA_DESC_ATTR_ACT2
+
+/* largest 32-bit aligned length that fits the 16-bit length field */
+#define ADMA_MAX_LEN		65532
+#define ADMA_MAX_DESCRIPTORS	1024
+#define ADMA_TABLE_SZ		(ADMA_MAX_DESCRIPTORS * \
+				 sizeof(struct omap_hsmmc_adma_desc))
+
 #define MMC_AUTOSUSPEND_DELAY	100
 #define MMC_TIMEOUT_MS		20		/* 20 mSec */
 #define MMC_TIMEOUT_US		20000		/* 20000 micro Sec */
@@ -172,6 +192,13 @@ struct omap_hsmmc_next {
 	s32		cookie;
 };
 
+struct omap_hsmmc_adma_desc {
+	u8		attr;
+	u8		reserved;
+	__le16		len;
+	__le32		addr;
+} __packed;
+
 struct omap_hsmmc_host {
 	struct	device		*dev;
 	struct	mmc_host	*mmc;
@@ -200,6 +227,10 @@ struct omap_hsmmc_host {
 	int			use_dma, dma_ch;
 	struct dma_chan		*tx_chan;
 	struct dma_chan		*rx_chan;
+	bool			use_adma;
+	bool			adma_active;
+	struct omap_hsmmc_adma_desc	*adma_desc_table;
+	dma_addr_t		adma_desc_table_addr;
 	int			response_busy;
 	int			context_loss;
 	int			protect_card;
@@ -572,6 +603,8 @@ static void omap_hsmmc_enable_irq(struct omap_hsmmc_host *host,
 
 	if (host->use_dma)
 		irq_mask &= ~(BRR_EN | BWR_EN);
+	if (!host->use_adma)
+		irq_mask &= ~ADMAE_EN;
 
 	/* Disable timeout for erases */
 	if (cmd->opcode == MMC_ERASE)
@@ -707,6 +740,26 @@ static void omap_hsmmc_set_bus_mode(struct omap_hsmmc_host *host)
 		OMAP_HSMMC_WRITE(host->base, CON, con & ~OD);
 }
 
+/*
+ * Select the controller's own ADMA2 engine instead of the external DMA
+ * request lines, or the other way round, as given by host->adma_active.
+ */
+static void omap_hsmmc_set_dma_mode(struct omap_hsmmc_host *host)
+{
+	u32 con, hctl;
+
+	con = OMAP_HSMMC_READ(host->base, CON);
+	hctl = OMAP_HSMMC_READ(host->base, HCTL) & ~DMA_MASK;
+	if (host->adma_active) {
+		con |= DMA_MNS;
+		hctl |= DMA_SELECT;
+	} else {
+		con &= ~DMA_MNS;
+	}
+	OMAP_HSMMC_WRITE(host->base, CON, con);
+	OMAP_HSMMC_WRITE(host->base, HCTL, hctl);
+}
+
 #ifdef CONFIG_PM
 
 /*
@@ -760,6 +813,8 @@ static int omap_hsmmc_context_restore(struct omap_hsmmc_host *host)
 	OMAP_HSMMC_WRITE(host->base, IE, 0);
 	OMAP_HSMMC_WRITE(host->base, STAT, STAT_CLEAR);
 
+	omap_hsmmc_set_dma_mode(host);
+
 	/* Do not initialize card-specific things if the power is off */
 	if (host->power_mode == MMC_POWER_OFF)
 		goto out;
@@ -931,6 +986,37 @@ static struct dma_chan *omap_hsmmc_get_dma_chan(struct omap_hsmmc_host *host,
 	return data->flags & MMC_DATA_WRITE ? host->tx_chan : host->rx_chan;
 }
 
+/*
+ * ADMA2 descriptors and the data port are 32 bits wide. Buffers that are
+ * not word aligned, as some SDIO function drivers pass, still go through
+ * the external DMA channels.
+ */
+static bool omap_hsmmc_data_adma(struct omap_hsmmc_host *host,
+	struct mmc_data *data)
+{
+	struct scatterlist *sg;
+	int i;
+
+	if (!host->use_adma)
+		return false;
+
+	for_each_sg(data->sg, sg, data->sg_len, i)
+		if ((sg->offset | sg->length) & 3)
+			return false;
+
+	return true;
+}
+
+/* The device the data buffers are mapped for */
+static struct device *omap_hsmmc_dma_dev(struct omap_hsmmc_host *host,
+	struct mmc_data *data)
+{
+	if (omap_hsmmc_data_adma(host, data))
+		return host->dev;
+
+	return omap_hsmmc_get_dma_chan(host, data)->device->dev;
+}
+
 static void omap_hsmmc_request_done(struct omap_hsmmc_host *host, struct mmc_request *mrq)
 {
 	int dma_ch;
@@ -949,6 +1035,26 @@ static void omap_hsmmc_request_done(struct omap_hsmmc_host *host, struct mmc_req
 	mmc_request_done(host->mmc, mrq);
 }
 
+/*
+ * The ADMA engine is done with the data once TC is raised, there is no
+ * separate DMA completion to wait for.
+ */
+static void omap_hsmmc_adma_done(struct omap_hsmmc_host *host,
+				 struct mmc_data *data)
+{
+	int dma_ch;
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->irq_lock, flags);
+	dma_ch = host->dma_ch;
+	host->dma_ch = -1;
+	spin_unlock_irqrestore(&host->irq_lock, flags);
+
+	if (dma_ch != -1 && !data->host_cookie)
+		dma_unmap_sg(host->dev, data->sg, data->sg_len,
+			     mmc_get_dma_dir(data));
+}
+
 /*
  * Notify the transfer complete to MMC core
  */
@@ -969,6 +1075,9 @@ omap_hsmmc_xfer_done(struct omap_hsmmc_host *host, struct mmc_data *data)
 		return;
 	}
 
+	if (host->adma_active)
+		omap_hsmmc_adma_done(host, data);
+
 	host->data = NULL;
 
 	if (!data->error)
@@ -1031,12 +1140,16 @@ static void omap_hsmmc_dma_cleanup(struct omap_hsmmc_host *host, int errno)
 	spin_unlock_irqrestore(&host->irq_lock, flags);
 
 	if (host->use_dma && dma_ch != -1) {
-		struct dma_chan *chan = omap_hsmmc_get_dma_chan(host, host->data);
+		struct device *dev = omap_hsmmc_dma_dev(host, host->data);
 
-		dmaengine_terminate_all(chan);
-		dma_unmap_sg(chan->device->dev,
-			host->data->sg, host->data->sg_len,
-			mmc_get_dma_dir(host->data));
+		if (host->adma_active)
+			dev_dbg(mmc_dev(host->mmc), "ADMA err: 0x%x\n",
+				OMAP_HSMMC_READ(host->base, ADMAES));
+		else
+			dmaengine_terminate_all(omap_hsmmc_get_dma_chan(host,
+								host->data));
+		dma_unmap_sg(dev, host->data->sg, host->data->sg_len,
+			     mmc_get_dma_dir(host->data));
 
 		host->data->host_cookie = 0;
 	}
@@ -1054,7 +1167,7 @@ static void omap_hsmmc_dbg_report_irq(struct omap_hsmmc_host *host, u32 status)
 		"CC"  , "TC"  , "BGE", "---", "BWR" , "BRR" , "---" , "---" ,
 		"CIRQ",	"OBI" , "---", "---", "---" , "---" , "---" , "ERRI",
 		"CTO" , "CCRC", "CEB", "CIE", "DTO" , "DCRC", "DEB" , "---" ,
-		"ACE" , "---" , "---", "---", "CERR", "BADA", "---" , "---"
+		"ACE" , "ADMA", "---", "---", "CERR", "BADA", "---" , "---"
 	};
 	char res[256];
 	char *buf = res;
@@ -1154,6 +1267,8 @@ static void omap_hsmmc_do_irq(struct omap_hsmmc_host *host, int status)
 		else if (status & (CCRC_EN | DCRC_EN | DEB_EN | CEB_EN |
 				   BADA_EN))
 			hsmmc_command_incomplete(host, -EILSEQ, end_cmd);
+		else if (status & ADMAE_EN)
+			hsmmc_command_incomplete(host, -EIO, end_cmd);
 
 		if (status & ACE_EN) {
 			u32 ac12;
@@ -1348,8 +1463,7 @@ static void omap_hsmmc_dma_callback(void *param)
 
 static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
 				       struct mmc_data *data,
-				       struct omap_hsmmc_next *next,
-				       struct dma_chan *chan)
+				       struct omap_hsmmc_next *next)
 {
 	int dma_len;
 
@@ -1363,8 +1477,8 @@ static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
 
 	/* Check if next job is already prepared */
 	if (next || data->host_cookie != host->next_data.cookie) {
-		dma_len = dma_map_sg(chan->device->dev, data->sg, data->sg_len,
-				     mmc_get_dma_dir(data));
+		dma_len = dma_map_sg(omap_hsmmc_dma_dev(host, data), data->sg,
+				     data->sg_len, mmc_get_dma_dir(data));
 
 	} else {
 		dma_len = host->next_data.dma_len;
@@ -1425,7 +1539,7 @@ static int omap_hsmmc_setup_dma_transfer(struct omap_hsmmc_host *host,
 	if (ret)
 		return ret;
 
-	ret = omap_hsmmc_pre_dma_transfer(host, data, NULL, chan);
+	ret = omap_hsmmc_pre_dma_transfer(host, data, NULL);
 	if (ret)
 		return ret;
 
@@ -1449,6 +1563,66 @@ static int omap_hsmmc_setup_dma_transfer(struct omap_hsmmc_host *host,
 	return 0;
 }
 
+/*
+ * Build the ADMA2 descriptor table for the whole scatterlist, so that a
+ * multi-block request runs as a single descriptor chain.
+ */
+static int omap_hsmmc_setup_adma_transfer(struct omap_hsmmc_host *host,
+					  struct mmc_request *req)
+{
+	struct mmc_data *data = req->data;
+	struct omap_hsmmc_adma_desc *desc = host->adma_desc_table;
+	struct scatterlist *sg;
+	unsigned int i, len, n = 0;
+	dma_addr_t addr;
+	int ret;
+
+	BUG_ON(host->dma_ch != -1);
+
+	ret = omap_hsmmc_pre_dma_transfer(host, data, NULL);
+	if (ret)
+		return ret;
+
+	for_each_sg(data->sg, sg, host->dma_len, i) {
+		addr = sg_dma_address(sg);
+		len = sg_dma_len(sg);
+
+		while (len) {
+			unsigned int chunk = min_t(unsigned int, len,
+						   ADMA_MAX_LEN);
+
+			if (n == ADMA_MAX_DESCRIPTORS)
+				goto err;
+
+			desc[n].attr = ADMA_DESC_ATTR_VALID |
+				       ADMA_DESC_TRANSFER_DATA;
+			desc[n].reserved = 0;
+			desc[n].len = cpu_to_le16(chunk);
+			desc[n].addr = cpu_to_le32(addr);
+			addr += chunk;
+			len -= chunk;
+			n++;
+		}
+	}
+	if (!n)
+		goto err;
+	desc[n - 1].attr |= ADMA_DESC_ATTR_END;
+
+	/* Table writes must land before ADMASAL starts the engine */
+	wmb();
+
+	host->dma_ch = 1;
+
+	return 0;
+
+err:
+	dev_err(mmc_dev(host->mmc), "cannot describe request in ADMA table\n");
+	if (!data->host_cookie)
+		dma_unmap_sg(host->dev, data->sg, data->sg_len,
+			     mmc_get_dma_dir(data));
+	return -EINVAL;
+}
+
 static void set_data_timeout(struct omap_hsmmc_host *host,
 			     unsigned long long timeout_ns,
 			     unsigned int timeout_clks)
@@ -1498,6 +1672,11 @@ static void omap_hsmmc_start_dma_transfer(struct omap_hsmmc_host *host)
 				| (req->data->blocks << 16));
 	set_data_timeout(host, req->data->timeout_ns,
 				req->data->timeout_clks);
+	if (host->adma_active) {
+		OMAP_HSMMC_WRITE(host->base, ADMASAL,
+				 host->adma_desc_table_addr);
+		return;
+	}
 	chan = omap_hsmmc_get_dma_chan(host, req->data);
 	dma_async_issue_pending(chan);
 }
@@ -1531,7 +1710,17 @@ omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 	}
 
 	if (host->use_dma) {
-		ret = omap_hsmmc_setup_dma_transfer(host, req);
+		bool adma = omap_hsmmc_data_adma(host, req->data);
+
+		if (adma != host->adma_active) {
+			host->adma_active = adma;
+			omap_hsmmc_set_dma_mode(host);
+		}
+
+		if (adma)
+			ret = omap_hsmmc_setup_adma_transfer(host, req);
+		else
+			ret = omap_hsmmc_setup_dma_transfer(host, req);
 		if (ret != 0) {
 			dev_err(mmc_dev(host->mmc), "MMC start dma failure\n");
 			return ret;
@@ -1547,10 +1736,8 @@ static void omap_hsmmc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
 	struct mmc_data *data = mrq->data;
 
 	if (host->use_dma && data->host_cookie) {
-		struct dma_chan *c = omap_hsmmc_get_dma_chan(host, data);
-
-		dma_unmap_sg(c->device->dev, data->sg, data->sg_len,
-			     mmc_get_dma_dir(data));
+		dma_unmap_sg(omap_hsmmc_dma_dev(host, data), data->sg,
+			     data->sg_len, mmc_get_dma_dir(data));
 		data->host_cookie = 0;
 	}
 }
@@ -1565,10 +1752,8 @@ static void omap_hsmmc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq)
 	}
 
 	if (host->use_dma) {
-		struct dma_chan *c = omap_hsmmc_get_dma_chan(host, mrq->data);
-
 		if (omap_hsmmc_pre_dma_transfer(host, mrq->data,
-						&host->next_data, c))
+						&host->next_data))
 			mrq->data->host_cookie = 0;
 	}
 }
@@ -1804,6 +1989,8 @@ static void omap_hsmmc_conf_bus_power(struct omap_hsmmc_host *host)
 
 	/* Set SD bus power bit */
 	set_sd_bus_power(host);
+
+	omap_hsmmc_set_dma_mode(host);
 }
 
 static int omap_hsmmc_multi_io_quirk(struct mmc_card *card,
@@ -2096,6 +2283,27 @@ static int omap_hsmmc_probe(struct platform_device *pdev)
 	mmc->max_req_size = mmc->max_blk_size * mmc->max_blk_count;
 	mmc->max_seg_size = mmc->max_req_size;
 
+	/*
+	 * With ADMA2 the controller walks the scatterlist itself. The table
+	 * holds one descriptor per segment, as many as the sDMA path allows,
+	 * and the external DMA channels are kept for unaligned buffers.
+	 */
+	if (OMAP_HSMMC_READ(host->base, CAPA) & CAPA_ADMA_SUPPORT) {
+		host->adma_desc_table = dmam_alloc_coherent(&pdev->dev,
+						ADMA_TABLE_SZ,
+						&host->adma_desc_table_addr,
+						GFP_KERNEL);
+		if (host->adma_desc_table) {
+			host->use_adma = true;
+			host->adma_active = true;
+		} else {
+			dev_warn(&pdev->dev, "no ADMA table, using sDMA\n");
+		}
+	}
+
+	if (host->use_adma)
+		mmc->max_seg_size = ADMA_MAX_LEN;
+
 	mmc->caps |= MMC_CAP_MMC_HIGHSPEED | MMC_CAP_SD_HIGHSPEED |
 		     MMC_CAP_WAIT_WHILE_BUSY | MMC_CAP_ERASE;
 
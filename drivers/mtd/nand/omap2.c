@@ -521,14 +521,12 @@ static inline int omap_nand_dma_transfer(struct mtd_info *mtd, void *addr,
 	return 0;
 
 out_copy_unmap:
+	dmaengine_terminate_all(info->dma);
 	dma_unmap_sg(info->dma->device->dev, &sg, 1, dir);
 out_copy:
-	if (info->nand.options & NAND_BUSWIDTH_16)
-		is_write == 0 ? omap_read_buf16(mtd, (u_char *) addr, len)
-			: omap_write_buf16(mtd, (u_char *) addr, len);
-	else
-		is_write == 0 ? omap_read_buf8(mtd, (u_char *) addr, len)
-			: omap_write_buf8(mtd, (u_char *) addr, len);
+	/* still go through the prefetch engine FIFO if it is free */
+	is_write == 0 ? omap_read_buf_pref(mtd, (u_char *) addr, len)
+		: omap_write_buf_pref(mtd, (u_char *) addr, len);
 	return 0;
 }
 
@@ -1954,6 +1952,12 @@ static int omap_nand_probe(struct platform_device *pdev)
 			}
 			nand_chip->read_buf   = omap_read_buf_dma_pref;
 			nand_chip->write_buf  = omap_write_buf_dma_pref;
+			/*
+			 * UBI and UBIFS hand vmalloc'ed buffers to MTD, have
+			 * the NAND core bounce those through its own page
+			 * buffer so that they are still moved by DMA.
+			 */
+			nand_chip->options |= NAND_USE_BOUNCE_BUFFER;
 		}
 		break;
 
@@ -87,8 +87,48 @@
 #include <linux/crc32.h>
 #include <linux/math64.h>
 #include <linux/random.h>
+#include <linux/workqueue.h>
 #include "ubi.h"
 
+/*
+ * Number of PEBs whose headers are read ahead in one go by the scanning
+ * worker, while the previous batch is being processed.
+ */
+#define SCAN_BATCH_PEBS 16
+
+/**
+ * struct ubi_peb_hdrs - UBI headers of a PEB as read from the flash.
+ * @ech: EC header
+ * @vidb: VID header buffer
+ * @bad: return value of 'ubi_io_is_bad()'
+ * @ec_err: return value of 'ubi_io_read_ec_hdr()'
+ * @vid_err: return value of 'ubi_io_read_vid_hdr()', only valid if the EC
+ *           header was not found empty
+ */
+struct ubi_peb_hdrs {
+	struct ubi_ec_hdr *ech;
+	struct ubi_vid_io_buf *vidb;
+	int bad;
+	int ec_err;
+	int vid_err;
+};
+
+/**
+ * struct ubi_scan_batch - a batch of PEBs read ahead during scanning.
+ * @work: the work reading the headers
+ * @ubi: UBI device description object
+ * @start: first PEB of the batch
+ * @count: number of PEBs in the batch
+ * @hdrs: the headers of PEBs @start to @start + @count - 1
+ */
+struct ubi_scan_batch {
+	struct work_struct work;
+	struct ubi_device *ubi;
+	int start;
+	int count;
+	struct ubi_peb_hdrs hdrs[SCAN_BATCH_PEBS];
+};
+
 static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
 
 #define AV_FIND		BIT(0)
@@ -940,30 +980,54 @@ static bool vol_ignored(int vol_id)
 }
 
 /**
- * scan_peb - scan and process UBI headers of a PEB.
+ * read_peb_hdrs - read UBI headers of a PEB.
+ * @ubi: UBI device description object
+ * @hdrs: where to store the headers and read results
+ * @pnum: the physical eraseblock number
+ *
+ * This function only does the I/O for 'process_peb()', it does not touch the
+ * attaching information and may run in parallel with processing other PEBs.
+ */
+static void read_peb_hdrs(struct ubi_device *ubi, struct ubi_peb_hdrs *hdrs,
+			  int pnum)
+{
+	hdrs->bad = ubi_io_is_bad(ubi, pnum);
+	if (hdrs->bad)
+		return;
+
+	hdrs->ec_err = ubi_io_read_ec_hdr(ubi, pnum, hdrs->ech, 0);
+	if (hdrs->ec_err < 0 || hdrs->ec_err == UBI_IO_FF ||
+	    hdrs->ec_err == UBI_IO_FF_BITFLIPS)
+		return;
+
+	hdrs->vid_err = ubi_io_read_vid_hdr(ubi, pnum, hdrs->vidb, 0);
+}
+
+/**
+ * process_peb - process UBI headers of a PEB.
  * @ubi: UBI device description object
  * @ai: attaching information
  * @pnum: the physical eraseblock number
+ * @hdrs: headers of the PEB as read by 'read_peb_hdrs()'
  * @fast: true if we're scanning for a Fastmap
  *
- * This function reads UBI headers of PEB @pnum, checks them, and adds
- * information about this PEB to the corresponding list or RB-tree in the
- * "attaching info" structure. Returns zero if the physical eraseblock was
- * successfully handled and a negative error code in case of failure.
+ * This function checks the UBI headers of PEB @pnum, and adds information
+ * about this PEB to the corresponding list or RB-tree in the "attaching info"
+ * structure. Returns zero if the physical eraseblock was successfully handled
+ * and a negative error code in case of failure.
  */
-static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
-		    int pnum, bool fast)
+static int process_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
+		       int pnum, struct ubi_peb_hdrs *hdrs, bool fast)
 {
-	struct ubi_ec_hdr *ech = ai->ech;
-	struct ubi_vid_io_buf *vidb = ai->vidb;
-	struct ubi_vid_hdr *vidh = ubi_get_vid_hdr(vidb);
+	struct ubi_ec_hdr *ech = hdrs->ech;
+	struct ubi_vid_hdr *vidh = ubi_get_vid_hdr(hdrs->vidb);
 	long long ec;
 	int err, bitflips = 0, vol_id = -1, ec_err = 0;
 
 	dbg_bld("scan PEB %d", pnum);
 
 	/* Skip bad physical eraseblocks */
-	err = ubi_io_is_bad(ubi, pnum);
+	err = hdrs->bad;
 	if (err < 0)
 		return err;
 	else if (err) {
@@ -971,7 +1035,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
-	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	err = hdrs->ec_err;
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -1054,7 +1118,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	/* OK, we've done with the EC header, let's look at the VID header */
 
-	err = ubi_io_read_vid_hdr(ubi, pnum, vidb, 0);
+	err = hdrs->vid_err;
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -1205,6 +1269,28 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	return 0;
 }
 
+/**
+ * scan_peb - scan and process UBI headers of a PEB.
+ * @ubi: UBI device description object
+ * @ai: attaching information
+ * @pnum: the physical eraseblock number
+ * @fast: true if we're scanning for a Fastmap
+ *
+ * This function reads UBI headers of PEB @pnum into the buffers of @ai and
+ * processes them, see 'process_peb()'.
+ */
+static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
+		    int pnum, bool fast)
+{
+	struct ubi_peb_hdrs hdrs = {
+		.ech = ai->ech,
+		.vidb = ai->vidb,
+	};
+
+	read_peb_hdrs(ubi, &hdrs, pnum);
+	return process_peb(ubi, ai, pnum, &hdrs, fast);
+}
+
 /**
  * late_analysis - analyze the overall situation with PEB.
  * @ubi: UBI device description object
@@ -1373,6 +1459,66 @@ static void destroy_ai(struct ubi_attach_info *ai)
 	kfree(ai);
 }
 
+static void scan_batch_worker(struct work_struct *work)
+{
+	struct ubi_scan_batch *batch = container_of(work, struct ubi_scan_batch,
+						    work);
+	int i;
+
+	for (i = 0; i < batch->count; i++)
+		read_peb_hdrs(batch->ubi, &batch->hdrs[i], batch->start + i);
+}
+
+static void free_scan_batch(struct ubi_scan_batch *batch)
+{
+	int i;
+
+	if (!batch)
+		return;
+
+	for (i = 0; i < SCAN_BATCH_PEBS; i++) {
+		ubi_free_vid_buf(batch->hdrs[i].vidb);
+		kfree(batch->hdrs[i].ech);
+	}
+	kfree(batch);
+}
+
+static struct ubi_scan_batch *alloc_scan_batch(struct ubi_device *ubi)
+{
+	struct ubi_scan_batch *batch;
+	int i;
+
+	batch = kzalloc(sizeof(struct ubi_scan_batch), GFP_KERNEL);
+	if (!batch)
+		return NULL;
+
+	INIT_WORK(&batch->work, scan_batch_worker);
+	batch->ubi = ubi;
+	for (i = 0; i < SCAN_BATCH_PEBS; i++) {
+		batch->hdrs[i].ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+		batch->hdrs[i].vidb = ubi_alloc_vid_buf(ubi, GFP_KERNEL);
+		if (!batch->hdrs[i].ech || !batch->hdrs[i].vidb) {
+			free_scan_batch(batch);
+			return NULL;
+		}
+	}
+
+	return batch;
+}
+
+/*
+ * Start reading the headers of the batch of PEBs starting at @start. Nothing
+ * is queued if @start is past the last PEB.
+ */
+static void queue_scan_batch(struct ubi_device *ubi,
+			     struct ubi_scan_batch *batch, int start)
+{
+	batch->start = start;
+	batch->count = min(ubi->peb_count - start, SCAN_BATCH_PEBS);
+	if (batch->count > 0)
+		queue_work(system_unbound_wq, &batch->work);
+}
+
 /**
  * scan_all - scan entire MTD device.
  * @ubi: UBI device description object
@@ -1386,10 +1532,11 @@ static void destroy_ai(struct ubi_attach_info *ai)
 static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		    int start)
 {
-	int err, pnum;
+	int err, i, cur = 0;
 	struct rb_node *rb1, *rb2;
 	struct ubi_ainf_volume *av;
 	struct ubi_ainf_peb *aeb;
+	struct ubi_scan_batch *batch[2] = {};
 
 	err = -ENOMEM;
 
@@ -1401,14 +1548,41 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (!ai->vidb)
 		goto out_ech;
 
-	for (pnum = start; pnum < ubi->peb_count; pnum++) {
-		cond_resched();
+	batch[0] = alloc_scan_batch(ubi);
+	batch[1] = alloc_scan_batch(ubi);
+	if (!batch[0] || !batch[1])
+		goto out_batch;
 
-		dbg_gen("process PEB %d", pnum);
-		err = scan_peb(ubi, ai, pnum, false);
-		if (err < 0)
-			goto out_vidh;
+	/*
+	 * The headers of the next batch of PEBs are read by a worker while
+	 * the current one is processed here, so that the flash is kept busy
+	 * and the I/O is issued back to back.
+	 */
+	err = 0;
+	queue_scan_batch(ubi, batch[0], start);
+	while (batch[cur]->count > 0) {
+		struct ubi_scan_batch *b = batch[cur];
+
+		flush_work(&b->work);
+		queue_scan_batch(ubi, batch[!cur], b->start + b->count);
+
+		for (i = 0; i < b->count; i++) {
+			cond_resched();
+
+			dbg_gen("process PEB %d", b->start + i);
+			err = process_peb(ubi, ai, b->start + i, &b->hdrs[i],
+					  false);
+			if (err < 0)
+				break;
+		}
+		if (err < 0) {
+			flush_work(&batch[!cur]->work);
+			goto out_batch;
+		}
+		cur = !cur;
 	}
+	free_scan_batch(batch[0]);
+	free_scan_batch(batch[1]);
 
 	ubi_msg(ubi, "scanning is finished");
 
@@ -1452,6 +1626,9 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	return 0;
 
+out_batch:
+	free_scan_batch(batch[0]);
+	free_scan_batch(batch[1]);
 out_vidh:
 	ubi_free_vid_buf(ai->vidb);
 out_ech:
@@ -469,6 +469,7 @@ int ubi_eba_unmap_leb(struct ubi_device *ubi, struct ubi_volume *vol,
 	if (ubi->ro_mode)
 		return -EROFS;
 
+	ubi_fg_io(ubi);
 	err = leb_write_lock(ubi, vol_id, lnum);
 	if (err)
 		return err;
@@ -517,6 +518,7 @@ int ubi_eba_read_leb(struct ubi_device *ubi, struct ubi_volume *vol, int lnum,
 	struct ubi_vid_hdr *vid_hdr;
 	uint32_t uninitialized_var(crc);
 
+	ubi_fg_io(ubi);
 	err = leb_read_lock(ubi, vol_id, lnum);
 	if (err)
 		return err;
@@ -925,6 +927,7 @@ int ubi_eba_write_leb(struct ubi_device *ubi, struct ubi_volume *vol, int lnum,
 	if (ubi->ro_mode)
 		return -EROFS;
 
+	ubi_fg_io(ubi);
 	err = leb_write_lock(ubi, vol_id, lnum);
 	if (err)
 		return err;
@@ -1023,6 +1026,7 @@ int ubi_eba_write_leb_st(struct ubi_device *ubi, struct ubi_volume *vol,
 	if (ubi->ro_mode)
 		return -EROFS;
 
+	ubi_fg_io(ubi);
 	if (lnum == used_ebs - 1)
 		/* If this is the last LEB @len may be unaligned */
 		len = ALIGN(data_size, ubi->min_io_size);
@@ -1101,6 +1105,7 @@ int ubi_eba_atomic_leb_change(struct ubi_device *ubi, struct ubi_volume *vol,
 	if (ubi->ro_mode)
 		return -EROFS;
 
+	ubi_fg_io(ubi);
 	if (len == 0) {
 		/*
 		 * Special case when data length is zero. In this case the LEB
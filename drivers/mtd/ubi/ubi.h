@@ -517,6 +517,7 @@ struct ubi_debug_info {
  * @move_to_put: if the "to" PEB was put
  * @works: list of pending works
  * @works_count: count of pending works
+ * @fg_io_stamp: time (in jiffies) of the last foreground I/O request
  * @bgt_thread: background thread description object
  * @thread_enabled: if the background thread is enabled
  * @bgt_name: background thread name
@@ -620,6 +621,7 @@ struct ubi_device {
 	int move_to_put;
 	struct list_head works;
 	int works_count;
+	unsigned long fg_io_stamp;
 	struct task_struct *bgt_thread;
 	int thread_enabled;
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
@@ -1156,6 +1158,17 @@ static inline void ubi_ro_mode(struct ubi_device *ubi)
 	}
 }
 
+/**
+ * ubi_fg_io - note a foreground I/O request.
+ * @ubi: UBI device description object
+ *
+ * The background thread holds wear-leveling back for a while after this.
+ */
+static inline void ubi_fg_io(struct ubi_device *ubi)
+{
+	WRITE_ONCE(ubi->fg_io_stamp, jiffies);
+}
+
 /**
  * vol_id2idx - get table index by volume ID.
  * @ubi: UBI device description object
@@ -135,6 +135,15 @@
  */
 #define WL_MAX_FAILURES 32
 
+/*
+ * The background thread holds back wear-leveling works while the device saw
+ * foreground I/O within the last %WL_IDLE_MS milliseconds, but never for more
+ * than %WL_MAX_DEFER_MS milliseconds in a row. Erase works are not deferred
+ * because writers may be waiting for the free PEBs they produce.
+ */
+#define WL_IDLE_MS 100
+#define WL_MAX_DEFER_MS 10000
+
 static int self_check_ec(struct ubi_device *ubi, int pnum, int ec);
 static int self_check_in_wl_tree(const struct ubi_device *ubi,
 				 struct ubi_wl_entry *e, struct rb_root *root);
@@ -191,14 +200,69 @@ static void wl_entry_destroy(struct ubi_device *ubi, struct ubi_wl_entry *e)
 	kmem_cache_free(ubi_wl_entry_slab, e);
 }
 
+static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
+				int shutdown);
+
+/**
+ * next_work - pick the pending work to do next.
+ * @ubi: UBI device description object
+ * @defer_wl: if wear-leveling works must not be picked
+ * @force_wl: if a wear-leveling work must be picked ahead of erase works
+ *
+ * Erase works go first, since they produce free physical eraseblocks.
+ * Wear-leveling works are only picked when nothing else is pending, unless
+ * @force_wl is set because they have been deferred for too long. Returns
+ * %NULL if there is nothing to do. Must be called with @ubi->wl_lock held.
+ */
+static struct ubi_work *next_work(struct ubi_device *ubi, bool defer_wl,
+				  bool force_wl)
+{
+	struct ubi_work *wrk;
+
+	if (force_wl)
+		list_for_each_entry(wrk, &ubi->works, list)
+			if (wrk->func == &wear_leveling_worker)
+				return wrk;
+
+	list_for_each_entry(wrk, &ubi->works, list)
+		if (wrk->func != &wear_leveling_worker)
+			return wrk;
+
+	if (defer_wl || list_empty(&ubi->works))
+		return NULL;
+
+	return list_first_entry(&ubi->works, struct ubi_work, list);
+}
+
+/**
+ * has_wl_work - check if a wear-leveling work is pending.
+ * @ubi: UBI device description object
+ *
+ * Must be called with @ubi->wl_lock held.
+ */
+static bool has_wl_work(struct ubi_device *ubi)
+{
+	struct ubi_work *wrk;
+
+	list_for_each_entry(wrk, &ubi->works, list)
+		if (wrk->func == &wear_leveling_worker)
+			return true;
+
+	return false;
+}
+
 /**
  * do_work - do one pending work.
  * @ubi: UBI device description object
+ * @defer_wl: leave wear-leveling works in the queue
+ * @force_wl: do a wear-leveling work ahead of erase works
+ * @wl_done: set to %true if a wear-leveling work was done, may be %NULL
  *
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  */
-static int do_work(struct ubi_device *ubi)
+static int do_work(struct ubi_device *ubi, bool defer_wl, bool force_wl,
+		   bool *wl_done)
 {
 	int err;
 	struct ubi_work *wrk;
@@ -213,18 +277,21 @@ static int do_work(struct ubi_device *ubi)
 	 */
 	down_read(&ubi->work_sem);
 	spin_lock(&ubi->wl_lock);
-	if (list_empty(&ubi->works)) {
+	wrk = next_work(ubi, defer_wl, force_wl);
+	if (!wrk) {
 		spin_unlock(&ubi->wl_lock);
 		up_read(&ubi->work_sem);
 		return 0;
 	}
 
-	wrk = list_entry(ubi->works.next, struct ubi_work, list);
 	list_del(&wrk->list);
 	ubi->works_count -= 1;
 	ubi_assert(ubi->works_count >= 0);
 	spin_unlock(&ubi->wl_lock);
 
+	if (wl_done)
+		*wl_done = wrk->func == &wear_leveling_worker;
+
 	/*
 	 * Call the worker function. Do not touch the work structure
 	 * after this call as it will have been freed or reused by that
@@ -1459,12 +1526,15 @@ int ubi_thread(void *u)
 {
 	int failures = 0;
 	struct ubi_device *ubi = u;
+	unsigned long defer_start = 0;
+	bool deferring = false;
 
 	ubi_msg(ubi, "background thread \"%s\" started, PID %d",
 		ubi->bgt_name, task_pid_nr(current));
 
 	set_freezable();
 	for (;;) {
+		bool defer_wl, force_wl, fg_busy, wl_done = false;
 		int err;
 
 		if (kthread_should_stop())
@@ -1481,9 +1551,40 @@ int ubi_thread(void *u)
 			schedule();
 			continue;
 		}
+
+		/*
+		 * Wear-leveling is held back while foreground I/O is going on,
+		 * but for no longer than WL_MAX_DEFER_MS. The deferral period
+		 * only ends once a wear-leveling work has actually been done
+		 * (or none is pending), and when it has expired the
+		 * wear-leveling work is picked ahead of the erase works so
+		 * that a steady stream of those cannot starve it.
+		 */
+		if (!has_wl_work(ubi))
+			deferring = false;
+		fg_busy = time_before(jiffies, READ_ONCE(ubi->fg_io_stamp) +
+				      msecs_to_jiffies(WL_IDLE_MS));
+		if (fg_busy && !deferring) {
+			deferring = true;
+			defer_start = jiffies;
+		}
+		force_wl = deferring &&
+			   time_after_eq(jiffies, defer_start +
+					 msecs_to_jiffies(WL_MAX_DEFER_MS));
+		defer_wl = fg_busy && !force_wl;
+
+		if (!next_work(ubi, defer_wl, force_wl)) {
+			/* Only wear-leveling left, look again when idle */
+			set_current_state(TASK_INTERRUPTIBLE);
+			spin_unlock(&ubi->wl_lock);
+			schedule_timeout(msecs_to_jiffies(WL_IDLE_MS));
+			continue;
+		}
 		spin_unlock(&ubi->wl_lock);
 
-		err = do_work(ubi);
+		err = do_work(ubi, defer_wl, force_wl, &wl_done);
+		if (wl_done)
+			deferring = false;
 		if (err) {
 			ubi_err(ubi, "%s: work failed with error code %d",
 				ubi->bgt_name, err);
@@ -1550,6 +1651,7 @@ int ubi_wl_init(struct ubi_device *ubi, struct ubi_attach_info *ai)
 	init_rwsem(&ubi->work_sem);
 	ubi->max_ec = ai->max_ec;
 	INIT_LIST_HEAD(&ubi->works);
+	ubi->fg_io_stamp = jiffies;
 
 	sprintf(ubi->bgt_name, UBI_BGT_NAME_PATTERN, ubi->ubi_num);
 
@@ -1856,7 +1958,7 @@ static int produce_free_peb(struct ubi_device *ubi)
 		spin_unlock(&ubi->wl_lock);
 
 		dbg_wl("do one work synchronously");
-		err = do_work(ubi);
+		err = do_work(ubi, false, false, NULL);
 
 		spin_lock(&ubi->wl_lock);
 		if (err)
@@ -37,6 +37,9 @@
 #ifdef CONFIG_PSTORE_LZ4_COMPRESS
 #include <linux/lz4.h>
 #endif
+#ifdef CONFIG_PSTORE_XZ_COMPRESS
+#include <linux/xz.h>
+#endif
 #include <linux/string.h>
 #include <linux/timer.h>
 #include <linux/slab.h>
@@ -82,6 +85,10 @@ static char *backend;
 #define WINDOW_BITS 12
 #define MEM_LEVEL 4
 static struct z_stream_s stream;
+#elif defined(CONFIG_PSTORE_XZ_COMPRESS)
+#define XZ_PRESET 3
+static struct xz_enc_lzma2 *xz_enc;
+static struct xz_dec_lzma2 *xz_dec;
 #else
 static unsigned char *workspace;
 #endif
@@ -402,6 +409,96 @@ static const struct pstore_zbackend backend_lz4 = {
 };
 #endif
 
+#ifdef CONFIG_PSTORE_XZ_COMPRESS
+/* Compressed records are the LZMA2 properties byte and a raw LZMA2 stream */
+static int compress_xz(const void *in, void *out, size_t inlen, size_t outlen)
+{
+	struct xz_buf b = {
+		.in		= in,
+		.in_size	= inlen,
+		.out		= out,
+		.out_pos	= 1,
+		.out_size	= outlen,
+	};
+	enum xz_ret ret;
+
+	if (outlen < 1)
+		return -EIO;
+
+	((u8 *)out)[0] = xz_enc_lzma2_props(xz_enc);
+	ret = xz_enc_lzma2_run(xz_enc, &b);
+	if (ret != XZ_STREAM_END) {
+		pr_err("xz_enc_lzma2_run error, ret = %d!\n", ret);
+		return -EIO;
+	}
+
+	return b.out_pos;
+}
+
+static int decompress_xz(void *in, void *out, size_t inlen, size_t outlen)
+{
+	struct xz_buf b = {
+		.in		= in,
+		.in_pos		= 1,
+		.in_size	= inlen,
+		.out		= out,
+		.out_size	= outlen,
+	};
+	enum xz_ret ret;
+
+	if (inlen < 1)
+		return -EIO;
+
+	ret = xz_dec_lzma2_reset(xz_dec, ((u8 *)in)[0]);
+	if (ret == XZ_OK)
+		ret = xz_dec_lzma2_run(xz_dec, &b);
+	if (ret != XZ_STREAM_END) {
+		pr_err("xz_dec_lzma2_run error, ret = %d!\n", ret);
+		return -EIO;
+	}
+
+	return b.out_pos;
+}
+
+static void free_xz(void)
+{
+	xz_enc_lzma2_end(xz_enc);
+	xz_enc = NULL;
+	if (xz_dec)
+		xz_dec_lzma2_end(xz_dec);
+	xz_dec = NULL;
+	kfree(big_oops_buf);
+	big_oops_buf = NULL;
+	big_oops_buf_sz = 0;
+}
+
+static void allocate_xz(void)
+{
+	/* Kernel logs typically compress to well below 40% with LZMA2. */
+	big_oops_buf_sz = (psinfo->bufsize * 100) / 40;
+	big_oops_buf = kmalloc(big_oops_buf_sz, GFP_KERNEL);
+	if (!big_oops_buf) {
+		pr_err("No memory for uncompressed data; skipping compression\n");
+		return;
+	}
+
+	xz_enc = xz_enc_lzma2_init(XZ_PRESET);
+	xz_dec = xz_dec_lzma2_create(XZ_SINGLE, 0);
+	if (!xz_enc || !xz_dec) {
+		pr_err("No memory for compression workspace; skipping compression\n");
+		free_xz();
+	}
+}
+
+static const struct pstore_zbackend backend_xz = {
+	.compress	= compress_xz,
+	.decompress	= decompress_xz,
+	.allocate	= allocate_xz,
+	.free		= free_xz,
+	.name		= "xz",
+};
+#endif
+
 static const struct pstore_zbackend *zbackend =
 #if defined(CONFIG_PSTORE_ZLIB_COMPRESS)
 	&backend_zlib;
@@ -409,6 +506,8 @@ static const struct pstore_zbackend *zbackend =
 	&backend_lzo;
 #elif defined(CONFIG_PSTORE_LZ4_COMPRESS)
 	&backend_lz4;
+#elif defined(CONFIG_PSTORE_XZ_COMPRESS)
+	&backend_xz;
 #else
 	NULL;
 #endif
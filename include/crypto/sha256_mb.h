@@ -0,0 +1,119 @@
+/*
+ * Multi buffer SHA256 job and context definitions shared by the arch
+ * specific job managers
+ *
+ * Copyright(c) 2016 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _CRYPTO_SHA256_MB_H
+#define _CRYPTO_SHA256_MB_H
+
+#include <linux/types.h>
+#include <crypto/sha.h>
+
+struct module;
+
+#define NUM_SHA256_DIGEST_WORDS 8
+
+enum job_sts {	STS_UNKNOWN = 0,
+		STS_BEING_PROCESSED = 1,
+		STS_COMPLETED = 2,
+		STS_INTERNAL_ERROR = 3,
+		STS_ERROR = 4
+};
+
+/* The layout is shared with the x86 AVX2 assembly, see _result_digest */
+struct job_sha256 {
+	u8	*buffer;
+	/* length in blocks */
+	u32	len;
+	u32	result_digest[NUM_SHA256_DIGEST_WORDS] __aligned(32);
+	enum	job_sts status;
+	void	*user_data;
+};
+
+#define HASH_UPDATE          0x00
+#define HASH_FIRST           0x01
+#define HASH_LAST            0x02
+#define HASH_ENTIRE          0x03
+#define HASH_DONE	     0x04
+#define HASH_FINAL	     0x08
+
+#define HASH_CTX_STS_IDLE       0x00
+#define HASH_CTX_STS_PROCESSING 0x01
+#define HASH_CTX_STS_LAST       0x02
+#define HASH_CTX_STS_COMPLETE   0x04
+
+enum hash_ctx_error {
+	HASH_CTX_ERROR_NONE               =  0,
+	HASH_CTX_ERROR_INVALID_FLAGS      = -1,
+	HASH_CTX_ERROR_ALREADY_PROCESSING = -2,
+	HASH_CTX_ERROR_ALREADY_COMPLETED  = -3,
+};
+
+#define hash_ctx_init(ctx) \
+	do { \
+		(ctx)->error = HASH_CTX_ERROR_NONE; \
+		(ctx)->status = HASH_CTX_STS_COMPLETE; \
+	} while (0)
+
+/* Hash Constants and Typedefs */
+#define SHA256_DIGEST_LENGTH        8
+#define SHA256_LOG2_BLOCK_SIZE        6
+
+#define SHA256_PADLENGTHFIELD_SIZE    8
+
+struct sha256_hash_ctx {
+	/* Must be at struct offset 0 */
+	struct job_sha256       job;
+	/* status flag */
+	int status;
+	/* error flag */
+	int error;
+
+	u64		total_length;
+	const void	*incoming_buffer;
+	u32		incoming_buffer_length;
+	u8		partial_block_buffer[SHA256_BLOCK_SIZE * 2];
+	u32		partial_block_buffer_length;
+	void		*user_data;
+};
+
+/**
+ * struct sha256_mb_ops - arch hooks of a multi-buffer SHA-256 implementation
+ * @mgr_size:		size of the per-CPU lane manager state
+ * @mgr_init:		mark all lanes of a zeroed lane manager unused
+ * @mgr_submit:		queue a job, returns a completed job or NULL
+ * @mgr_flush:		hash the occupied lanes until a job completes,
+ *			returns NULL when no job is in flight
+ * @mgr_get_comp_job:	return a job that completed without hashing or NULL
+ * @simd_begin:		claim the SIMD unit before the lane manager is called
+ * @simd_end:		release the SIMD unit
+ * @internal_driver_name: driver name of the internal "__sha256-mb" algorithm
+ * @driver_name:	driver name of the async "sha256" algorithm
+ * @priority:		priority of the async "sha256" algorithm
+ * @owner:		module providing the hooks
+ */
+struct sha256_mb_ops {
+	size_t			mgr_size;
+	void			(*mgr_init)(void *mgr);
+	struct job_sha256	*(*mgr_submit)(void *mgr,
+					       struct job_sha256 *job);
+	struct job_sha256	*(*mgr_flush)(void *mgr);
+	struct job_sha256	*(*mgr_get_comp_job)(void *mgr);
+	void			(*simd_begin)(void);
+	void			(*simd_end)(void);
+	const char		*internal_driver_name;
+	const char		*driver_name;
+	int			priority;
+	struct module		*owner;
+};
+
+int sha256_mb_register(const struct sha256_mb_ops *ops);
+void sha256_mb_unregister(const struct sha256_mb_ops *ops);
+
+#endif /* _CRYPTO_SHA256_MB_H */
@@ -47,6 +47,12 @@ struct pt_regs;
  * @kobj:		kobject used to represent this struct in sysfs
  * @dir:		/proc/irq/ procfs entry
  * @debugfs_file:	dentry for the debugfs file
+ * @balance_time:	time spent in hard interrupt handlers (ns)
+ * @balance_time_last:	value of @balance_time at the last balancing pass
+ * @balance_delta:	handler time during the last balancing interval
+ * @balance_cpu:	cpu which handled the interrupt last
+ * @balance_target:	cpu the interrupt was last moved to by the balancer
+ * @balance_owned:	affinity was last set by the in-kernel balancer
  * @name:		flow handler name for /proc/interrupts output
  */
 struct irq_desc {
@@ -92,6 +98,14 @@ struct irq_desc {
 #ifdef CONFIG_GENERIC_IRQ_DEBUGFS
 	struct dentry		*debugfs_file;
 #endif
+#ifdef CONFIG_IRQ_BALANCE
+	u64			balance_time;
+	u64			balance_time_last;
+	u64			balance_delta;
+	unsigned int		balance_cpu;
+	unsigned int		balance_target;
+	bool			balance_owned;
+#endif
 #ifdef CONFIG_SPARSE_IRQ
 	struct rcu_head		rcu;
 	struct kobject		kobj;
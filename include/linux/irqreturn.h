@@ -6,11 +6,14 @@
  * @IRQ_NONE		interrupt was not from this device or was not handled
  * @IRQ_HANDLED		interrupt was handled by this device
  * @IRQ_WAKE_THREAD	handler requests to wake the handler thread
+ * @IRQ_POLL_MORE	thread handler of an IRQF_THREAD_POLL interrupt has
+ *			more work pending and wants to be polled again
  */
 enum irqreturn {
 	IRQ_NONE		= (0 << 0),
 	IRQ_HANDLED		= (1 << 0),
 	IRQ_WAKE_THREAD		= (1 << 1),
+	IRQ_POLL_MORE		= (1 << 2),
 };
 
 typedef enum irqreturn irqreturn_t;
@@ -299,21 +299,23 @@ int LZ4_decompress_safe(const char *source, char *dest, int compressedSize,
  * @dest: output buffer address of the decompressed data which must be
  *	already allocated
  * @compressedSize: is the precise full size of the compressed block.
- * @targetOutputSize: the decompression operation will try
- *	to stop as soon as 'targetOutputSize' has been reached
+ * @targetOutputSize: the decompression operation stops
+ *	once 'targetOutputSize' bytes have been decoded
  * @maxDecompressedSize: is the size of destination buffer
  *
- * This function decompresses a compressed block of size 'compressedSize'
- * at position 'source' into destination buffer 'dest'
+ * This function decompresses the beginning of a compressed block of size
+ * 'compressedSize' at position 'source' into destination buffer 'dest'
  * of size 'maxDecompressedSize'.
- * The function tries to stop decompressing operation as soon as
- * 'targetOutputSize' has been reached, reducing decompression time.
+ * Decoding stops exactly after min('targetOutputSize',
+ * 'maxDecompressedSize') bytes, even in the middle of a literal run or
+ * a match, so 'dest' only needs to hold the part that is wanted, e.g.
+ * the first page of a larger compressed block.
  * This function never writes outside of output buffer,
  * and never reads outside of input buffer.
  * It is therefore protected against malicious data packets.
  *
  * Return: the number of bytes decoded in the destination buffer
- *	(necessarily <= maxDecompressedSize)
+ *	(less than the target only if the block is shorter)
  *	or a negative result in case of error
  *
  */
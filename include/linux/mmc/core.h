@@ -127,9 +127,17 @@ struct mmc_data {
 
 #define MMC_DATA_WRITE	(1 << 8)
 #define MMC_DATA_READ	(1 << 9)
+/* Extra flags used by CQE */
+#define MMC_DATA_QBR		(1 << 10)	/* CQE queue barrier*/
+#define MMC_DATA_PRIO		(1 << 11)	/* CQE high priority */
+#define MMC_DATA_REL_WR		(1 << 12)	/* Reliable write */
+#define MMC_DATA_DAT_TAG	(1 << 13)	/* Tag request */
+#define MMC_DATA_FORCED_PRG	(1 << 14)	/* Forced programming */
 
 	unsigned int		bytes_xfered;
 
+	u32			blk_addr;	/* block address, used by CQE */
+
 	struct mmc_command	*stop;		/* stop command */
 	struct mmc_request	*mrq;		/* associated request */
 
@@ -149,10 +157,18 @@ struct mmc_request {
 	struct completion	completion;
 	struct completion	cmd_completion;
 	void			(*done)(struct mmc_request *);/* completion function */
+	/*
+	 * Notify uppers layers (e.g. mmc block driver) that recovery is needed
+	 * due to an error associated with the mmc_request. Currently used only
+	 * by CQE.
+	 */
+	void			(*recovery_notifier)(struct mmc_request *);
 	struct mmc_host		*host;
 
 	/* Allow other commands during this ongoing data transfer or busy wait */
 	bool			cap_cmd_during_tfr;
+
+	int			tag;		/* CQE task tag */
 };
 
 struct mmc_card;
@@ -573,6 +573,19 @@ struct perf_event {
 	struct list_head		group_entry;
 	struct list_head		sibling_list;
 
+	/*
+	 * Node in the context's pinned or flexible groups tree, keyed on
+	 * {cpu, group_index}; only used by group leaders.
+	 */
+	struct rb_node			group_node;
+	u64				group_index;
+
+	/*
+	 * Entry in the context's pinned_active or flexible_active list
+	 * while the group is scheduled in; only used by group leaders.
+	 */
+	struct list_head		active_list;
+
 	/*
 	 * We need storage to track the entries in perf_pmu_migrate_context; we
 	 * cannot use the event_entry because of RCU and we want to keep the
@@ -721,6 +734,17 @@ struct perf_event {
 #endif /* CONFIG_PERF_EVENTS */
 };
 
+/**
+ * struct perf_event_groups - event groups of a context
+ * @tree:	rb-tree of group leaders, sorted by {cpu, cgroup id, group_index}
+ * @index:	last group_index handed out; inserting a group places it
+ *		last in its {cpu, cgroup} subtree, which rotation relies on
+ */
+struct perf_event_groups {
+	struct rb_root			tree;
+	u64				index;
+};
+
 /**
  * struct perf_event_context - event context structure
  *
@@ -741,8 +765,10 @@ struct perf_event_context {
 	struct mutex			mutex;
 
 	struct list_head		active_ctx_list;
-	struct list_head		pinned_groups;
-	struct list_head		flexible_groups;
+	struct perf_event_groups	pinned_groups;
+	struct perf_event_groups	flexible_groups;
+	struct list_head		pinned_active;
+	struct list_head		flexible_active;
 	struct list_head		event_list;
 	int				nr_events;
 	int				nr_active;
@@ -794,6 +820,11 @@ struct perf_cpu_context {
 	ktime_t				hrtimer_interval;
 	unsigned int			hrtimer_active;
 
+	/* multiplexing statistics, see perf_event_mux_stats in sysfs */
+	unsigned long			mux_rotations;
+	unsigned long			mux_scheduled;
+	unsigned long			mux_missed;
+
 #ifdef CONFIG_CGROUP_PERF
 	struct perf_cgroup		*cgrp;
 	struct list_head		cgrp_cpuctx_entry;
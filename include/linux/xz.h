@@ -1,5 +1,5 @@
 /*
- * XZ decompressor
+ * XZ decompressor and LZMA2 compressor
  *
  * Authors: Lasse Collin <lasse.collin@tukaani.org>
  *          Igor Pavlov <http://7-zip.org/>
@@ -233,6 +233,119 @@ XZ_EXTERN void xz_dec_reset(struct xz_dec *s);
  */
 XZ_EXTERN void xz_dec_end(struct xz_dec *s);
 
+/**
+ * struct xz_dec_lzma2 - Opaque type to hold the raw LZMA2 decoder state
+ */
+struct xz_dec_lzma2;
+
+/**
+ * xz_dec_lzma2_create() - Allocate memory for a raw LZMA2 decoder
+ * @mode:       Operation mode
+ * @dict_max:   Maximum size of the LZMA2 dictionary, see xz_dec_init()
+ *
+ * This decoder handles raw LZMA2 streams without the .xz container, such
+ * as the output of xz_enc_lzma2_run(). xz_dec_lzma2_reset() must be used
+ * before calling xz_dec_lzma2_run(). Returns NULL if memory allocation
+ * fails.
+ */
+XZ_EXTERN struct xz_dec_lzma2 *xz_dec_lzma2_create(enum xz_mode mode,
+						   uint32_t dict_max);
+
+/**
+ * xz_dec_lzma2_reset() - Prepare the raw LZMA2 decoder for a new stream
+ * @s:          Decoder state allocated using xz_dec_lzma2_create()
+ * @props:      LZMA2 properties byte, which encodes the dictionary size
+ *
+ * Returns XZ_OK on success, XZ_MEMLIMIT_ERROR if the preallocated
+ * dictionary is not big enough, and XZ_OPTIONS_ERROR if props indicates
+ * something that this decoder doesn't support.
+ */
+XZ_EXTERN enum xz_ret xz_dec_lzma2_reset(struct xz_dec_lzma2 *s,
+					 uint8_t props);
+
+/**
+ * xz_dec_lzma2_run() - Decode raw LZMA2 stream from b->in to b->out
+ * @s:          Decoder state allocated using xz_dec_lzma2_create()
+ * @b:          Input and output buffers
+ *
+ * Returns XZ_STREAM_END once the LZMA2 end marker has been decoded. Unlike
+ * xz_dec_run(), this returns XZ_OK also in single-call mode if the input
+ * ends before the end marker; the caller must treat that as an error.
+ */
+XZ_EXTERN enum xz_ret xz_dec_lzma2_run(struct xz_dec_lzma2 *s,
+				       struct xz_buf *b);
+
+/**
+ * xz_dec_lzma2_end() - Free the memory allocated for the LZMA2 decoder
+ * @s:          Decoder state allocated using xz_dec_lzma2_create()
+ */
+XZ_EXTERN void xz_dec_lzma2_end(struct xz_dec_lzma2 *s);
+
+/*
+ * Highest compression preset accepted by xz_enc_lzma2_init(). Like with
+ * the xz command line tool, higher presets compress better but are slower
+ * and use more memory.
+ */
+#define XZ_PRESET_MAX 9
+
+/*
+ * The encoder is never part of a pre-boot decompressor, so unlike the
+ * decoder functions above, its functions are always declared extern
+ * even if XZ_EXTERN has been defined to static.
+ */
+
+/**
+ * struct xz_enc_lzma2 - Opaque type to hold the LZMA2 encoder state
+ */
+struct xz_enc_lzma2;
+
+/**
+ * xz_enc_lzma2_init() - Allocate and initialize a LZMA2 encoder state
+ * @preset:     Compression preset, 0 to XZ_PRESET_MAX
+ *
+ * The preset selects the history window (64 KiB to 1 MiB), how many
+ * match candidates are examined, and whether lazy matching is used. The
+ * encoder needs 4 bytes of memory per byte of history window plus about
+ * 350 KiB of fixed tables, all of which is allocated here, so
+ * xz_enc_lzma2_run() never allocates memory.
+ *
+ * Returns NULL if preset is invalid or memory allocation fails.
+ */
+extern struct xz_enc_lzma2 *xz_enc_lzma2_init(uint32_t preset);
+
+/**
+ * xz_enc_lzma2_run() - Compress a buffer into a raw LZMA2 stream
+ * @s:          Encoder state allocated using xz_enc_lzma2_init()
+ * @b:          Input and output buffers
+ *
+ * The encoder works in single-call mode only: all input from
+ * b->in[b->in_pos] to b->in[b->in_size] is compressed at once, including
+ * the LZMA2 end marker.
+ *
+ * Returns XZ_STREAM_END on success, with b->in_pos set to b->in_size and
+ * b->out_pos advanced past the compressed data. Returns XZ_BUF_ERROR if
+ * the output buffer is too small, in which case b->in_pos and b->out_pos
+ * are not modified.
+ */
+extern enum xz_ret xz_enc_lzma2_run(struct xz_enc_lzma2 *s,
+				    struct xz_buf *b);
+
+/**
+ * xz_enc_lzma2_props() - Get the LZMA2 properties byte of the encoder
+ * @s:          Encoder state allocated using xz_enc_lzma2_init()
+ *
+ * The decoder needs this value for xz_dec_lzma2_reset(). It doesn't
+ * change between calls to xz_enc_lzma2_run().
+ */
+extern uint8_t xz_enc_lzma2_props(const struct xz_enc_lzma2 *s);
+
+/**
+ * xz_enc_lzma2_end() - Free the memory allocated for the encoder state
+ * @s:          Encoder state allocated using xz_enc_lzma2_init(). If s is
+ *              NULL, this function does nothing.
+ */
+extern void xz_enc_lzma2_end(struct xz_enc_lzma2 *s);
+
 /*
  * Standalone build (userspace build or in-kernel build for boot time use)
  * needs a CRC32 implementation. For normal in-kernel use, kernel's own
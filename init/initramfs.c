@@ -19,6 +19,9 @@
 #include <linux/syscalls.h>
 #include <linux/utime.h>
 #include <linux/file.h>
+#include <linux/async.h>
+#include <linux/export.h>
+#include <linux/kmod.h>
 
 static ssize_t __init xwrite(int fd, const char *p, size_t count)
 {
@@ -606,7 +609,7 @@ static void __init clean_rootfs(void)
 }
 #endif
 
-static int __init populate_rootfs(void)
+static void __init do_populate_rootfs(void *unused, async_cookie_t cookie)
 {
 	/* Load the built in initramfs */
 	char *err = unpack_to_rootfs(__initramfs_start, __initramfs_size);
@@ -653,12 +656,66 @@ static int __init populate_rootfs(void)
 #endif
 	}
 	flush_delayed_fput();
+}
+
+static bool __initdata initramfs_async = true;
+static int __init initramfs_async_setup(char *str)
+{
+	strtobool(str, &initramfs_async);
+	return 1;
+}
+__setup("initramfs_async=", initramfs_async_setup);
+
+static ASYNC_DOMAIN_EXCLUSIVE(initramfs_domain);
+static async_cookie_t initramfs_cookie;
+
+/*
+ * Wait until the initramfs (and, if present, the bootloader supplied
+ * initrd) has been unpacked into rootfs.  Anything that may look up files
+ * in rootfs before the first userspace exec - usermode helpers, firmware
+ * loading, opening the initial console - must call this first.
+ */
+void wait_for_initramfs(void)
+{
+	if (!initramfs_cookie) {
+		/*
+		 * Something before rootfs_initcall wants to access
+		 * the filesystem/initramfs. Probably a bug. Make a
+		 * note, avoid deadlocking the machine, and let the
+		 * caller's access fail as it used to.
+		 */
+		pr_warn_once("wait_for_initramfs() called before rootfs_initcalls\n");
+		return;
+	}
+	async_synchronize_cookie_domain(initramfs_cookie + 1, &initramfs_domain);
+}
+EXPORT_SYMBOL_GPL(wait_for_initramfs);
+
+static int __init populate_rootfs(void)
+{
 	/*
-	 * Try loading default modules from initramfs.  This gives
-	 * us a chance to load before device_initcalls.
+	 * Decompressing and unpacking a large initramfs can take a long
+	 * time, so by default do it asynchronously and let device probing
+	 * proceed in parallel.  initramfs_async=0 restores the old
+	 * synchronous behaviour.
 	 */
-	load_default_modules();
-
+	initramfs_cookie = async_schedule_domain(do_populate_rootfs, NULL,
+						 &initramfs_domain);
+	/*
+	 * From here on wait_for_initramfs() synchronizes with the unpacking,
+	 * so usermode helpers can safely look for their binaries.
+	 */
+	usermodehelper_enable();
+	if (!initramfs_async) {
+		wait_for_initramfs();
+		/*
+		 * Try loading default modules from initramfs.  This gives
+		 * us a chance to load before device_initcalls.  In the
+		 * asynchronous case they are loaded right before init is
+		 * exec'd instead.
+		 */
+		load_default_modules();
+	}
 	return 0;
 }
 rootfs_initcall(populate_rootfs);
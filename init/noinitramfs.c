@@ -20,6 +20,7 @@
 #include <linux/init.h>
 #include <linux/stat.h>
 #include <linux/kdev_t.h>
+#include <linux/kmod.h>
 #include <linux/syscalls.h>
 
 /*
@@ -43,10 +44,12 @@ static int __init default_rootfs(void)
 	if (err < 0)
 		goto out;
 
+	usermodehelper_enable();
 	return 0;
 
 out:
 	printk(KERN_WARNING "Failed to create a rootfs\n");
+	usermodehelper_enable();
 	return err;
 }
 rootfs_initcall(default_rootfs);
@@ -688,6 +688,71 @@ perf_cgroup_set_timestamp(struct task_struct *task,
 
 static DEFINE_PER_CPU(struct list_head, cgrp_cpuctx_list);
 
+/*
+ * Cursor storage for visit_groups_merge(): two slots for the groups not
+ * bound to a cgroup plus one per level of the deepest cgroup that has
+ * events on this CPU. It is only used on the local CPU with interrupts
+ * disabled and only grows, see perf_cgroup_ensure_cursors().
+ */
+struct perf_merge_cursors {
+	int			nr;
+	struct perf_event	*evt[];
+};
+
+static DEFINE_PER_CPU(struct perf_merge_cursors *, perf_merge_cursors);
+static DEFINE_MUTEX(perf_merge_cursors_mutex);
+
+static int __perf_merge_cursors_swap(void *info)
+{
+	struct perf_merge_cursors **new = info;
+	struct perf_merge_cursors *old = __this_cpu_read(perf_merge_cursors);
+
+	if (!old || old->nr < (*new)->nr) {
+		__this_cpu_write(perf_merge_cursors, *new);
+		*new = old;
+	}
+	return 0;
+}
+
+static int perf_cgroup_ensure_cursors(int cpu, struct cgroup *cgrp)
+{
+	struct perf_merge_cursors *cursors;
+	int nr = 2 + cgrp->level + 1;
+
+	mutex_lock(&perf_merge_cursors_mutex);
+	cursors = per_cpu(perf_merge_cursors, cpu);
+	if (cursors && cursors->nr >= nr) {
+		mutex_unlock(&perf_merge_cursors_mutex);
+		return 0;
+	}
+
+	cursors = kzalloc_node(sizeof(*cursors) + nr * sizeof(cursors->evt[0]),
+			       GFP_KERNEL, cpu_to_node(cpu));
+	if (!cursors) {
+		mutex_unlock(&perf_merge_cursors_mutex);
+		return -ENOMEM;
+	}
+	cursors->nr = nr;
+
+	/*
+	 * Publish the new storage from the CPU itself, so that it cannot
+	 * be in the middle of a merge. Offline CPUs do not schedule events
+	 * and hotplug is held off while we swap behind their back.
+	 */
+	cpus_read_lock();
+	if (cpu_function_call(cpu, __perf_merge_cursors_swap, &cursors)) {
+		struct perf_merge_cursors *old = per_cpu(perf_merge_cursors, cpu);
+
+		per_cpu(perf_merge_cursors, cpu) = cursors;
+		cursors = old;
+	}
+	cpus_read_unlock();
+	mutex_unlock(&perf_merge_cursors_mutex);
+
+	kfree(cursors);
+	return 0;
+}
+
 #define PERF_CGROUP_SWOUT	0x1 /* cgroup switch out every event */
 #define PERF_CGROUP_SWIN	0x2 /* cgroup switch in events based on task */
 
@@ -816,6 +881,12 @@ static inline int perf_cgroup_connect(int fd, struct perf_event *event,
 		goto out;
 	}
 
+	ret = perf_cgroup_ensure_cursors(event->cpu, css->cgroup);
+	if (ret) {
+		css_put(css);
+		goto out;
+	}
+
 	cgrp = container_of(css, struct perf_cgroup, css);
 	event->cgrp = cgrp;
 
@@ -1459,8 +1530,21 @@ static enum event_type_t get_event_type(struct perf_event *event)
 	return event_type;
 }
 
-static struct list_head *
-ctx_group_list(struct perf_event *event, struct perf_event_context *ctx)
+/*
+ * Helper function to initialize event group nodes.
+ */
+static void init_event_group(struct perf_event *event)
+{
+	RB_CLEAR_NODE(&event->group_node);
+	event->group_index = 0;
+}
+
+/*
+ * Extract pinned or flexible groups from the context
+ * based on event attrs bits.
+ */
+static struct perf_event_groups *
+get_event_groups(struct perf_event *event, struct perf_event_context *ctx)
 {
 	if (event->attr.pinned)
 		return &ctx->pinned_groups;
@@ -1468,6 +1552,177 @@ ctx_group_list(struct perf_event *event, struct perf_event_context *ctx)
 		return &ctx->flexible_groups;
 }
 
+/*
+ * Helper function to initialize perf_event_group trees.
+ */
+static void perf_event_groups_init(struct perf_event_groups *groups)
+{
+	groups->tree = RB_ROOT;
+	groups->index = 0;
+}
+
+/*
+ * Cgroup part of the groups key; 0 for events not bound to a cgroup.
+ * Cgroup events pin their css, so the id is stable and unique within
+ * the perf_event hierarchy for as long as the event exists.
+ */
+static inline int perf_event_cgroup_id(struct perf_event *event)
+{
+#ifdef CONFIG_CGROUP_PERF
+	if (event->cgrp)
+		return event->cgrp->css.cgroup->id;
+#endif
+	return 0;
+}
+
+/*
+ * Compare {@cpu, @cgrp_id} with the {cpu, cgroup} part of @event's key.
+ */
+static inline int
+perf_event_groups_cmp(int cpu, int cgrp_id, struct perf_event *event)
+{
+	if (cpu != event->cpu)
+		return cpu < event->cpu ? -1 : 1;
+	if (cgrp_id != perf_event_cgroup_id(event))
+		return cgrp_id < perf_event_cgroup_id(event) ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Compare function for event groups;
+ *
+ * Implements a complex key that first sorts by CPU, then by cgroup and
+ * then by virtual index, which provides ordering when rotating groups of
+ * the same CPU and cgroup.
+ */
+static bool
+perf_event_groups_less(struct perf_event *left, struct perf_event *right)
+{
+	int cmp;
+
+	cmp = perf_event_groups_cmp(left->cpu, perf_event_cgroup_id(left),
+				    right);
+	if (cmp)
+		return cmp < 0;
+
+	return left->group_index < right->group_index;
+}
+
+/*
+ * Insert @event into @groups' tree; using {@event->cpu, cgroup,
+ * ++@groups->index} for key (see perf_event_groups_less). This places it
+ * last inside the {CPU, cgroup} subtree.
+ */
+static void
+perf_event_groups_insert(struct perf_event_groups *groups,
+			 struct perf_event *event)
+{
+	struct perf_event *node_event;
+	struct rb_node *parent = NULL;
+	struct rb_node **node;
+
+	event->group_index = ++groups->index;
+
+	node = &groups->tree.rb_node;
+	while (*node) {
+		parent = *node;
+		node_event = container_of(*node, struct perf_event, group_node);
+
+		if (perf_event_groups_less(event, node_event))
+			node = &parent->rb_left;
+		else
+			node = &parent->rb_right;
+	}
+
+	rb_link_node(&event->group_node, parent, node);
+	rb_insert_color(&event->group_node, &groups->tree);
+}
+
+/*
+ * Helper function to insert event into the pinned or flexible groups.
+ */
+static void
+add_event_to_groups(struct perf_event *event, struct perf_event_context *ctx)
+{
+	perf_event_groups_insert(get_event_groups(event, ctx), event);
+}
+
+/*
+ * Delete a group from a tree.
+ */
+static void
+perf_event_groups_delete(struct perf_event_groups *groups,
+			 struct perf_event *event)
+{
+	WARN_ON_ONCE(RB_EMPTY_NODE(&event->group_node) ||
+		     RB_EMPTY_ROOT(&groups->tree));
+
+	rb_erase(&event->group_node, &groups->tree);
+	init_event_group(event);
+}
+
+/*
+ * Helper function to delete event from its groups.
+ */
+static void
+del_event_from_groups(struct perf_event *event, struct perf_event_context *ctx)
+{
+	perf_event_groups_delete(get_event_groups(event, ctx), event);
+}
+
+/*
+ * Get the leftmost event in the {@cpu, @cgrp_id} subtree.
+ */
+static struct perf_event *
+perf_event_groups_first(struct perf_event_groups *groups, int cpu, int cgrp_id)
+{
+	struct perf_event *node_event = NULL, *match = NULL;
+	struct rb_node *node = groups->tree.rb_node;
+	int cmp;
+
+	while (node) {
+		node_event = container_of(node, struct perf_event, group_node);
+
+		cmp = perf_event_groups_cmp(cpu, cgrp_id, node_event);
+		if (cmp < 0) {
+			node = node->rb_left;
+		} else if (cmp > 0) {
+			node = node->rb_right;
+		} else {
+			match = node_event;
+			node = node->rb_left;
+		}
+	}
+
+	return match;
+}
+
+/*
+ * Like rb_entry_next_safe() for the {cpu, cgroup} subtree.
+ */
+static struct perf_event *
+perf_event_groups_next(struct perf_event *event)
+{
+	struct perf_event *next;
+
+	next = rb_entry_safe(rb_next(&event->group_node), typeof(*event),
+			     group_node);
+	if (next && !perf_event_groups_cmp(event->cpu,
+					   perf_event_cgroup_id(event), next))
+		return next;
+
+	return NULL;
+}
+
+/*
+ * Iterate through the whole groups tree.
+ */
+#define perf_event_groups_for_each(event, groups)			\
+	for (event = rb_entry_safe(rb_first(&((groups)->tree)),		\
+				   typeof(*event), group_node); event;	\
+	     event = rb_entry_safe(rb_next(&event->group_node),		\
+				   typeof(*event), group_node))
+
 /*
  * Add a event from the lists for its context.
  * Must be called with ctx->mutex and ctx->lock held.
@@ -1486,12 +1741,8 @@ list_add_event(struct perf_event *event, struct perf_event_context *ctx)
 	 * perf_group_detach can, at all times, locate all siblings.
 	 */
 	if (event->group_leader == event) {
-		struct list_head *list;
-
 		event->group_caps = event->event_caps;
-
-		list = ctx_group_list(event, ctx);
-		list_add_tail(&event->group_entry, list);
+		add_event_to_groups(event, ctx);
 	}
 
 	list_update_cgroup_event(event, ctx, true);
@@ -1682,7 +1933,7 @@ list_del_event(struct perf_event *event, struct perf_event_context *ctx)
 	list_del_rcu(&event->event_entry);
 
 	if (event->group_leader == event)
-		list_del_init(&event->group_entry);
+		del_event_from_groups(event, ctx);
 
 	update_group_times(event);
 
@@ -1702,7 +1953,6 @@ list_del_event(struct perf_event *event, struct perf_event_context *ctx)
 static void perf_group_detach(struct perf_event *event)
 {
 	struct perf_event *sibling, *tmp;
-	struct list_head *list = NULL;
 
 	lockdep_assert_held(&event->ctx->lock);
 
@@ -1723,22 +1973,30 @@ static void perf_group_detach(struct perf_event *event)
 		goto out;
 	}
 
-	if (!list_empty(&event->group_entry))
-		list = &event->group_entry;
-
 	/*
 	 * If this was a group event with sibling events then
 	 * upgrade the siblings to singleton events by adding them
-	 * to whatever list we are on.
+	 * to whatever groups tree we are on.
 	 */
 	list_for_each_entry_safe(sibling, tmp, &event->sibling_list, group_entry) {
-		if (list)
-			list_move_tail(&sibling->group_entry, list);
 		sibling->group_leader = sibling;
 
 		/* Inherit group flags from the previous leader */
 		sibling->group_caps = event->group_caps;
 
+		if (!RB_EMPTY_NODE(&event->group_node)) {
+			list_del_init(&sibling->group_entry);
+			add_event_to_groups(sibling, event->ctx);
+
+			if (sibling->state == PERF_EVENT_STATE_ACTIVE) {
+				struct list_head *list = sibling->attr.pinned ?
+					&event->ctx->pinned_active :
+					&event->ctx->flexible_active;
+
+				list_add_tail(&sibling->active_list, list);
+			}
+		}
+
 		WARN_ON_ONCE(sibling->ctx != event->ctx);
 	}
 
@@ -1815,6 +2073,13 @@ event_sched_out(struct perf_event *event,
 	if (event->state != PERF_EVENT_STATE_ACTIVE)
 		return;
 
+	/*
+	 * Asymmetry; we only schedule groups _IN_ through ctx_sched_in(),
+	 * but we can schedule events _OUT_ individually through things like
+	 * __perf_remove_from_context().
+	 */
+	list_del_init(&event->active_list);
+
 	perf_pmu_disable(event->pmu);
 
 	event->tstamp_stopped = tstamp;
@@ -2705,7 +2970,7 @@ static void ctx_sched_out(struct perf_event_context *ctx,
 			  enum event_type_t event_type)
 {
 	int is_active = ctx->is_active;
-	struct perf_event *event;
+	struct perf_event *event, *tmp;
 
 	lockdep_assert_held(&ctx->lock);
 
@@ -2752,12 +3017,14 @@ static void ctx_sched_out(struct perf_event_context *ctx,
 
 	perf_pmu_disable(ctx->pmu);
 	if (is_active & EVENT_PINNED) {
-		list_for_each_entry(event, &ctx->pinned_groups, group_entry)
+		list_for_each_entry_safe(event, tmp, &ctx->pinned_active,
+					 active_list)
 			group_sched_out(event, cpuctx, ctx);
 	}
 
 	if (is_active & EVENT_FLEXIBLE) {
-		list_for_each_entry(event, &ctx->flexible_groups, group_entry)
+		list_for_each_entry_safe(event, tmp, &ctx->flexible_active,
+					 active_list)
 			group_sched_out(event, cpuctx, ctx);
 	}
 	perf_pmu_enable(ctx->pmu);
@@ -3052,63 +3319,169 @@ static void cpu_ctx_sched_out(struct perf_cpu_context *cpuctx,
 	ctx_sched_out(&cpuctx->ctx, cpuctx, event_type);
 }
 
-static void
-ctx_pinned_sched_in(struct perf_event_context *ctx,
-		    struct perf_cpu_context *cpuctx)
+/*
+ * Visit the groups of @ctx that can run on this CPU: the ones that can
+ * run anywhere (cpu == -1), the ones bound to this CPU and, for the CPU
+ * context, the ones attached to the current cgroup or one of its
+ * ancestors. Groups of other cgroups are never looked at. The subtrees
+ * are merged on group_index so that the rotation order is kept across
+ * them.
+ */
+static int visit_groups_merge(struct perf_cpu_context *cpuctx,
+			      struct perf_event_context *ctx,
+			      struct perf_event_groups *groups,
+			      int (*func)(struct perf_event *, void *),
+			      void *data)
 {
-	struct perf_event *event;
+	int cpu = smp_processor_id();
+	struct perf_event *local[2], **evt = local;
+	int i, min, nr = 0, ret;
 
-	list_for_each_entry(event, &ctx->pinned_groups, group_entry) {
-		if (event->state <= PERF_EVENT_STATE_OFF)
-			continue;
-		if (!event_filter_match(event))
-			continue;
+	evt[nr++] = perf_event_groups_first(groups, -1, 0);
+	evt[nr++] = perf_event_groups_first(groups, cpu, 0);
 
-		/* may need to reset tstamp_enabled */
-		if (is_cgroup_event(event))
-			perf_cgroup_mark_enabled(event, ctx);
+#ifdef CONFIG_CGROUP_PERF
+	if (ctx == &cpuctx->ctx && cpuctx->cgrp) {
+		struct perf_merge_cursors *cursors;
+		struct cgroup *cgrp = cpuctx->cgrp->css.cgroup;
+		int level;
 
-		if (group_can_go_on(event, cpuctx, 1))
-			group_sched_in(event, cpuctx, ctx);
+		cursors = __this_cpu_read(perf_merge_cursors);
+		if (cursors) {
+			evt = cursors->evt;
+			evt[0] = local[0];
+			evt[1] = local[1];
 
-		/*
-		 * If this pinned group hasn't been scheduled,
-		 * put it in error state.
-		 */
-		if (event->state == PERF_EVENT_STATE_INACTIVE) {
-			update_group_times(event);
-			event->state = PERF_EVENT_STATE_ERROR;
+			/*
+			 * Cgroups deeper than the storage can not have
+			 * events on this CPU, see perf_cgroup_ensure_cursors().
+			 */
+			for (level = 0; level <= cgrp->level &&
+					nr < cursors->nr; level++) {
+				evt[nr++] = perf_event_groups_first(groups, cpu,
+						cgrp->ancestor_ids[level]);
+			}
+		}
+	}
+#endif
+
+	for (;;) {
+		min = -1;
+		for (i = 0; i < nr; i++) {
+			if (evt[i] && (min < 0 ||
+				       evt[i]->group_index < evt[min]->group_index))
+				min = i;
 		}
+		if (min < 0)
+			break;
+
+		ret = func(evt[min], data);
+		if (ret)
+			return ret;
+
+		evt[min] = perf_event_groups_next(evt[min]);
 	}
+
+	return 0;
 }
 
-static void
-ctx_flexible_sched_in(struct perf_event_context *ctx,
-		      struct perf_cpu_context *cpuctx)
+struct sched_in_data {
+	struct perf_event_context *ctx;
+	struct perf_cpu_context *cpuctx;
+};
+
+static int pinned_sched_in(struct perf_event *event, void *data)
 {
-	struct perf_event *event;
-	int can_add_hw = 1;
+	struct sched_in_data *sid = data;
 
-	list_for_each_entry(event, &ctx->flexible_groups, group_entry) {
-		/* Ignore events in OFF or ERROR state */
-		if (event->state <= PERF_EVENT_STATE_OFF)
-			continue;
-		/*
-		 * Listen to the 'cpu' scheduling filter constraint
-		 * of events:
-		 */
-		if (!event_filter_match(event))
-			continue;
+	if (event->state <= PERF_EVENT_STATE_OFF)
+		return 0;
 
-		/* may need to reset tstamp_enabled */
-		if (is_cgroup_event(event))
-			perf_cgroup_mark_enabled(event, ctx);
+	if (!event_filter_match(event))
+		return 0;
 
-		if (group_can_go_on(event, cpuctx, can_add_hw)) {
-			if (group_sched_in(event, cpuctx, ctx))
-				can_add_hw = 0;
-		}
+	/* may need to reset tstamp_enabled */
+	if (is_cgroup_event(event))
+		perf_cgroup_mark_enabled(event, sid->ctx);
+
+	if (group_can_go_on(event, sid->cpuctx, 1) &&
+	    !group_sched_in(event, sid->cpuctx, sid->ctx))
+		list_add_tail(&event->active_list, &sid->ctx->pinned_active);
+
+	/*
+	 * If this pinned group hasn't been scheduled,
+	 * put it in error state.
+	 */
+	if (event->state == PERF_EVENT_STATE_INACTIVE) {
+		update_group_times(event);
+		event->state = PERF_EVENT_STATE_ERROR;
 	}
+
+	return 0;
+}
+
+/*
+ * A flexible group that does not fit on the PMU does not end the scan:
+ * groups further down may still fit in the counters that are left, so
+ * we keep packing. Rotation moves the head group to the tail on every
+ * multiplexing tick, so a large group still gets the first pick of the
+ * counters in turn.
+ */
+static int flexible_sched_in(struct perf_event *event, void *data)
+{
+	struct sched_in_data *sid = data;
+	struct perf_cpu_context *cpuctx = sid->cpuctx;
+
+	/* Ignore events in OFF or ERROR state */
+	if (event->state <= PERF_EVENT_STATE_OFF)
+		return 0;
+
+	/*
+	 * Listen to the 'cpu' scheduling filter constraint
+	 * of events:
+	 */
+	if (!event_filter_match(event))
+		return 0;
+
+	/* may need to reset tstamp_enabled */
+	if (is_cgroup_event(event))
+		perf_cgroup_mark_enabled(event, sid->ctx);
+
+	if (group_can_go_on(event, cpuctx, 1) &&
+	    !group_sched_in(event, cpuctx, sid->ctx)) {
+		list_add_tail(&event->active_list, &sid->ctx->flexible_active);
+		cpuctx->mux_scheduled++;
+	} else {
+		cpuctx->mux_missed++;
+	}
+
+	return 0;
+}
+
+static void
+ctx_pinned_sched_in(struct perf_event_context *ctx,
+		    struct perf_cpu_context *cpuctx)
+{
+	struct sched_in_data sid = {
+		.ctx = ctx,
+		.cpuctx = cpuctx,
+	};
+
+	visit_groups_merge(cpuctx, ctx, &ctx->pinned_groups,
+			   pinned_sched_in, &sid);
+}
+
+static void
+ctx_flexible_sched_in(struct perf_event_context *ctx,
+		      struct perf_cpu_context *cpuctx)
+{
+	struct sched_in_data sid = {
+		.ctx = ctx,
+		.cpuctx = cpuctx,
+	};
+
+	visit_groups_merge(cpuctx, ctx, &ctx->flexible_groups,
+			   flexible_sched_in, &sid);
 }
 
 static void
@@ -3182,7 +3555,7 @@ static void perf_event_context_sched_in(struct perf_event_context *ctx,
 	 * However, if task's ctx is not carrying any pinned
 	 * events, no need to flip the cpuctx's events around.
 	 */
-	if (!list_empty(&ctx->pinned_groups))
+	if (!RB_EMPTY_ROOT(&ctx->pinned_groups.tree))
 		cpu_ctx_sched_out(cpuctx, EVENT_FLEXIBLE);
 	perf_event_sched_in(cpuctx, ctx, task);
 	perf_pmu_enable(ctx->pmu);
@@ -3408,17 +3781,36 @@ static void perf_adjust_freq_unthr_context(struct perf_event_context *ctx,
 	raw_spin_unlock(&ctx->lock);
 }
 
+static int first_group(struct perf_event *event, void *data)
+{
+	*(struct perf_event **)data = event;
+	return 1;
+}
+
 /*
  * Round-robin a context's events:
  */
-static void rotate_ctx(struct perf_event_context *ctx)
+static void rotate_ctx(struct perf_cpu_context *cpuctx,
+		       struct perf_event_context *ctx)
 {
+	struct perf_event *event = NULL;
+
 	/*
-	 * Rotate the first entry last of non-pinned groups. Rotation might be
-	 * disabled by the inheritance code.
+	 * Rotation might be disabled by the inheritance code.
 	 */
-	if (!ctx->rotate_disable)
-		list_rotate_left(&ctx->flexible_groups);
+	if (ctx->rotate_disable)
+		return;
+
+	/*
+	 * Rotate the first entry last of the non-pinned groups that are
+	 * visible on this CPU; reinserting it hands out a new group_index.
+	 */
+	visit_groups_merge(cpuctx, ctx, &ctx->flexible_groups,
+			   first_group, &event);
+	if (event) {
+		perf_event_groups_delete(&ctx->flexible_groups, event);
+		perf_event_groups_insert(&ctx->flexible_groups, event);
+	}
 }
 
 static int perf_rotate_context(struct perf_cpu_context *cpuctx)
@@ -3447,9 +3839,10 @@ static int perf_rotate_context(struct perf_cpu_context *cpuctx)
 	if (ctx)
 		ctx_sched_out(ctx, cpuctx, EVENT_FLEXIBLE);
 
-	rotate_ctx(&cpuctx->ctx);
+	rotate_ctx(cpuctx, &cpuctx->ctx);
 	if (ctx)
-		rotate_ctx(ctx);
+		rotate_ctx(cpuctx, ctx);
+	cpuctx->mux_rotations++;
 
 	perf_event_sched_in(cpuctx, ctx, current);
 
@@ -3757,8 +4150,10 @@ static void __perf_event_init_context(struct perf_event_context *ctx)
 	raw_spin_lock_init(&ctx->lock);
 	mutex_init(&ctx->mutex);
 	INIT_LIST_HEAD(&ctx->active_ctx_list);
-	INIT_LIST_HEAD(&ctx->pinned_groups);
-	INIT_LIST_HEAD(&ctx->flexible_groups);
+	perf_event_groups_init(&ctx->pinned_groups);
+	perf_event_groups_init(&ctx->flexible_groups);
+	INIT_LIST_HEAD(&ctx->pinned_active);
+	INIT_LIST_HEAD(&ctx->flexible_active);
 	INIT_LIST_HEAD(&ctx->event_list);
 	atomic_set(&ctx->refcount, 1);
 }
@@ -4533,6 +4928,13 @@ perf_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
 	struct perf_event_context *ctx;
 	int ret;
 
+	/*
+	 * FMODE_PREAD is only there for splice(); read() has no notion of
+	 * a position, so refuse to pretend to honour one.
+	 */
+	if (*ppos)
+		return -ESPIPE;
+
 	ctx = perf_event_ctx_lock(event);
 	ret = __perf_read(event, buf, count);
 	perf_event_ctx_unlock(event, ctx);
@@ -5420,10 +5822,29 @@ static int perf_fasync(int fd, struct file *filp, int on)
 	return 0;
 }
 
+static ssize_t perf_splice_read(struct file *file, loff_t *ppos,
+				struct pipe_inode_info *pipe, size_t len,
+				unsigned int flags)
+{
+	struct perf_event *event = file->private_data;
+	struct ring_buffer *rb;
+	ssize_t ret;
+
+	rb = ring_buffer_get(event);
+	if (!rb)
+		return -EINVAL;
+
+	ret = rb_splice_read(rb, ppos, pipe, len);
+	ring_buffer_put(rb);
+
+	return ret;
+}
+
 static const struct file_operations perf_fops = {
 	.llseek			= no_llseek,
 	.release		= perf_release,
 	.read			= perf_read,
+	.splice_read		= perf_splice_read,
 	.poll			= perf_poll,
 	.unlocked_ioctl		= perf_ioctl,
 	.compat_ioctl		= perf_compat_ioctl,
@@ -8957,9 +9378,40 @@ perf_event_mux_interval_ms_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(perf_event_mux_interval_ms);
 
+/*
+ * Multiplexing statistics summed over all CPUs: the number of rotations
+ * and how often flexible groups were scheduled in or left out when the
+ * PMU was programmed. missed / (scheduled + missed) is the share of PMU
+ * time the flexible groups lost to multiplexing.
+ */
+static ssize_t
+perf_event_mux_stats_show(struct device *dev,
+			  struct device_attribute *attr,
+			  char *page)
+{
+	struct pmu *pmu = dev_get_drvdata(dev);
+	unsigned long rotations = 0, scheduled = 0, missed = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct perf_cpu_context *cpuctx;
+
+		cpuctx = per_cpu_ptr(pmu->pmu_cpu_context, cpu);
+		rotations += READ_ONCE(cpuctx->mux_rotations);
+		scheduled += READ_ONCE(cpuctx->mux_scheduled);
+		missed += READ_ONCE(cpuctx->mux_missed);
+	}
+
+	return snprintf(page, PAGE_SIZE-1,
+			"rotations %lu\nscheduled %lu\nmissed %lu\n",
+			rotations, scheduled, missed);
+}
+static DEVICE_ATTR_RO(perf_event_mux_stats);
+
 static struct attribute *pmu_dev_attrs[] = {
 	&dev_attr_type.attr,
 	&dev_attr_perf_event_mux_interval_ms.attr,
+	&dev_attr_perf_event_mux_stats.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(pmu_dev);
@@ -9381,6 +9833,8 @@ perf_event_alloc(struct perf_event_attr *attr, int cpu,
 	INIT_LIST_HEAD(&event->group_entry);
 	INIT_LIST_HEAD(&event->event_entry);
 	INIT_LIST_HEAD(&event->sibling_list);
+	INIT_LIST_HEAD(&event->active_list);
+	init_event_group(event);
 	INIT_LIST_HEAD(&event->rb_entry);
 	INIT_LIST_HEAD(&event->active_entry);
 	INIT_LIST_HEAD(&event->addr_filters.list);
@@ -10053,6 +10507,8 @@ SYSCALL_DEFINE5(perf_event_open,
 		event_file = NULL;
 		goto err_context;
 	}
+	/* splice() takes the ring buffer position as offset */
+	event_file->f_mode |= FMODE_PREAD;
 
 	if (move_group) {
 		gctx = __perf_event_ctx_lock_double(group_leader, ctx);
@@ -10885,7 +11341,7 @@ static int perf_event_init_context(struct task_struct *child, int ctxn)
 	 * We dont have to disable NMIs - we are only looking at
 	 * the list, not manipulating it:
 	 */
-	list_for_each_entry(event, &parent_ctx->pinned_groups, group_entry) {
+	perf_event_groups_for_each(event, &parent_ctx->pinned_groups) {
 		ret = inherit_task_group(event, parent, parent_ctx,
 					 child, ctxn, &inherited_all);
 		if (ret)
@@ -10901,7 +11357,7 @@ static int perf_event_init_context(struct task_struct *child, int ctxn)
 	parent_ctx->rotate_disable = 1;
 	raw_spin_unlock_irqrestore(&parent_ctx->lock, flags);
 
-	list_for_each_entry(event, &parent_ctx->flexible_groups, group_entry) {
+	perf_event_groups_for_each(event, &parent_ctx->flexible_groups) {
 		ret = inherit_task_group(event, parent, parent_ctx,
 					 child, ctxn, &inherited_all);
 		if (ret)
@@ -93,6 +93,10 @@ void perf_event_aux_event(struct perf_event *event, unsigned long head,
 extern struct page *
 perf_mmap_to_page(struct ring_buffer *rb, unsigned long pgoff);
 
+struct pipe_inode_info;
+extern ssize_t rb_splice_read(struct ring_buffer *rb, loff_t *ppos,
+			      struct pipe_inode_info *pipe, size_t len);
+
 #ifdef CONFIG_PERF_USE_VMALLOC
 /*
  * Back perf_mmap() with vmalloc memory.
@@ -14,6 +14,8 @@
 #include <linux/slab.h>
 #include <linux/circ_buf.h>
 #include <linux/poll.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
 
 #include "internal.h"
 
@@ -862,3 +864,166 @@ perf_mmap_to_page(struct ring_buffer *rb, unsigned long pgoff)
 
 	return __perf_mmap_to_page(rb, pgoff);
 }
+
+/*
+ * splice() support: data or AUX pages are handed to the pipe as they are.
+ * Every pipe buffer holds a reference on the ring buffer, and for AUX
+ * pages on the AUX area, so the pages stay around while they sit in the
+ * pipe. The tail is left alone: as with mmap, the reader advances it once
+ * the data has left the pipe, which keeps the producer off those pages.
+ */
+static void perf_pipe_buf_release(struct pipe_inode_info *pipe,
+				  struct pipe_buffer *buf)
+{
+	ring_buffer_put((struct ring_buffer *)buf->private);
+}
+
+static void perf_pipe_buf_get(struct pipe_inode_info *pipe,
+			      struct pipe_buffer *buf)
+{
+	atomic_inc(&((struct ring_buffer *)buf->private)->refcount);
+}
+
+static void perf_aux_pipe_buf_release(struct pipe_inode_info *pipe,
+				      struct pipe_buffer *buf)
+{
+	struct ring_buffer *rb = (struct ring_buffer *)buf->private;
+
+	rb_free_aux(rb);
+	ring_buffer_put(rb);
+}
+
+static void perf_aux_pipe_buf_get(struct pipe_inode_info *pipe,
+				  struct pipe_buffer *buf)
+{
+	struct ring_buffer *rb = (struct ring_buffer *)buf->private;
+
+	atomic_inc(&rb->aux_refcount);
+	atomic_inc(&rb->refcount);
+}
+
+/* The pages belong to the ring buffer, they can not be stolen */
+static int perf_pipe_buf_steal(struct pipe_inode_info *pipe,
+			       struct pipe_buffer *buf)
+{
+	return 1;
+}
+
+static const struct pipe_buf_operations perf_pipe_buf_ops = {
+	.can_merge = 0,
+	.confirm = generic_pipe_buf_confirm,
+	.release = perf_pipe_buf_release,
+	.steal = perf_pipe_buf_steal,
+	.get = perf_pipe_buf_get,
+};
+
+static const struct pipe_buf_operations perf_aux_pipe_buf_ops = {
+	.can_merge = 0,
+	.confirm = generic_pipe_buf_confirm,
+	.release = perf_aux_pipe_buf_release,
+	.steal = perf_pipe_buf_steal,
+	.get = perf_aux_pipe_buf_get,
+};
+
+/* Drop the references of pages splice_to_pipe() did not take */
+static void perf_splice_page_release(struct splice_pipe_desc *spd,
+				     unsigned int i)
+{
+	struct ring_buffer *rb = (struct ring_buffer *)spd->partial[i].private;
+
+	if (spd->ops == &perf_aux_pipe_buf_ops)
+		rb_free_aux(rb);
+	ring_buffer_put(rb);
+}
+
+ssize_t rb_splice_read(struct ring_buffer *rb, loff_t *ppos,
+		       struct pipe_inode_info *pipe, size_t len)
+{
+	struct page *pages[PIPE_DEF_BUFFERS];
+	struct partial_page partial[PIPE_DEF_BUFFERS];
+	struct splice_pipe_desc spd = {
+		.pages = pages,
+		.partial = partial,
+		.nr_pages_max = PIPE_DEF_BUFFERS,
+		.ops = &perf_pipe_buf_ops,
+		.spd_release = perf_splice_page_release,
+	};
+	bool aux = *ppos & PERF_SPLICE_AUX;
+	u64 pos = *ppos & ~PERF_SPLICE_AUX;
+	unsigned long size, base;
+	u64 head, tail;
+	ssize_t ret;
+
+	if (aux) {
+		if (!atomic_inc_not_zero(&rb->aux_refcount))
+			return -EINVAL;
+		ret = -EINVAL;
+		if (!rb_has_aux(rb) || rb->aux_overwrite)
+			goto out;
+
+		spd.ops = &perf_aux_pipe_buf_ops;
+		size = perf_aux_size(rb);
+		base = rb->aux_pgoff;
+		head = READ_ONCE(rb->user_page->aux_head);
+		tail = READ_ONCE(rb->user_page->aux_tail);
+	} else {
+		if (rb->overwrite || !rb->nr_pages)
+			return -EINVAL;
+
+		size = perf_data_size(rb);
+		base = 1;
+		head = READ_ONCE(rb->user_page->data_head);
+		tail = READ_ONCE(rb->user_page->data_tail);
+	}
+	/* Pairs with the smp_wmb() before the head is published */
+	smp_rmb();
+
+	ret = -EINVAL;
+	if (pos - tail > head - tail)
+		goto out;
+
+	ret = 0;
+	len = min_t(u64, len, head - pos);
+	if (!len)
+		goto out;
+
+	ret = -ENOMEM;
+	if (splice_grow_spd(pipe, &spd))
+		goto out;
+
+	while (len && spd.nr_pages < spd.nr_pages_max) {
+		unsigned long offset = pos & (size - 1);
+		unsigned int poff = offset & ~PAGE_MASK;
+		unsigned int this_len = min_t(size_t, len, PAGE_SIZE - poff);
+		struct page *page;
+
+		page = perf_mmap_to_page(rb, base + (offset >> PAGE_SHIFT));
+		if (WARN_ON_ONCE(!page))
+			break;
+
+		atomic_inc(&rb->refcount);
+		if (aux)
+			atomic_inc(&rb->aux_refcount);
+
+		spd.pages[spd.nr_pages] = page;
+		spd.partial[spd.nr_pages].offset = poff;
+		spd.partial[spd.nr_pages].len = this_len;
+		spd.partial[spd.nr_pages].private = (unsigned long)rb;
+		spd.nr_pages++;
+
+		pos += this_len;
+		len -= this_len;
+	}
+
+	ret = 0;
+	if (spd.nr_pages)
+		ret = splice_to_pipe(pipe, &spd);
+	if (ret > 0)
+		*ppos += ret;
+
+	splice_shrink_spd(&spd);
+out:
+	if (aux)
+		rb_free_aux(rb);
+	return ret;
+}
@@ -0,0 +1,277 @@
+/*
+ * linux/kernel/irq/balance.c
+ *
+ * In-kernel interrupt load balancing.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * When enabled, the time spent in the hard interrupt handlers of every
+ * interrupt is accounted in its descriptor, together with the CPU that
+ * handled it last.  A periodic work item sums that time up per CPU and,
+ * if a CPU spends too much of the interval in interrupt handlers, moves
+ * its heaviest movable interrupt to the least loaded CPU of the same
+ * NUMA node.
+ *
+ * Only interrupts whose affinity was left at the default (or was last set
+ * by the balancer itself) are moved.  Per-CPU interrupts, interrupts
+ * marked IRQ_NO_BALANCING and interrupts with kernel managed affinity are
+ * never touched.
+ */
+#include <linux/kernel.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/static_key.h>
+#include <linux/topology.h>
+#include <linux/workqueue.h>
+
+#include "internals.h"
+
+#ifdef MODULE_PARAM_PREFIX
+#undef MODULE_PARAM_PREFIX
+#endif
+#define MODULE_PARAM_PREFIX "irqbalance."
+
+DEFINE_STATIC_KEY_FALSE(irq_balance_enabled);
+
+/* Balancing interval in milliseconds. */
+static unsigned int interval_ms = 1000;
+module_param(interval_ms, uint, 0644);
+
+/*
+ * Percentage of the interval a CPU has to spend in interrupt handlers
+ * before any of its interrupts are moved away.
+ */
+static unsigned int threshold_pct = 10;
+module_param(threshold_pct, uint, 0644);
+
+/* Maximum number of interrupts migrated per balancing pass. */
+static unsigned int max_moves = 4;
+module_param(max_moves, uint, 0644);
+
+static bool irq_balance_requested;
+static bool irq_balance_ready;
+static DEFINE_MUTEX(irq_balance_mutex);
+
+static u64 *irq_balance_load;
+static cpumask_var_t irq_balance_candidates;
+
+static void irq_balance_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(irq_balance_work, irq_balance_work_fn);
+
+static void irq_balance_schedule(void)
+{
+	queue_delayed_work(system_unbound_wq, &irq_balance_work,
+			   msecs_to_jiffies(max(interval_ms, 10U)));
+}
+
+/*
+ * Can the balancer move this interrupt?  Leave alone anything that is
+ * per-CPU, excluded from balancing, managed by the kernel, or whose
+ * affinity was narrowed by somebody else than the balancer.
+ */
+static bool irq_balance_movable(struct irq_desc *desc)
+{
+	struct irq_data *d = irq_desc_get_irq_data(desc);
+	const struct cpumask *mask = irq_data_get_affinity_mask(d);
+
+	if (!desc->action || !irq_can_set_affinity_usr(irq_desc_get_irq(desc)))
+		return false;
+
+	if (desc->balance_owned &&
+	    cpumask_equal(mask, cpumask_of(desc->balance_target)))
+		return true;
+
+	return cpumask_subset(irq_default_affinity, mask);
+}
+
+/*
+ * Fill irq_balance_candidates with the CPUs the interrupt may be moved
+ * to: online CPUs of the default affinity, restricted to the interrupt's
+ * NUMA node when that node has any.
+ */
+static void irq_balance_get_candidates(struct irq_desc *desc)
+{
+	int node = irq_desc_get_node(desc);
+
+	cpumask_and(irq_balance_candidates, irq_default_affinity,
+		    cpu_online_mask);
+	if (node != NUMA_NO_NODE &&
+	    cpumask_intersects(irq_balance_candidates, cpumask_of_node(node)))
+		cpumask_and(irq_balance_candidates, irq_balance_candidates,
+			    cpumask_of_node(node));
+}
+
+/* Sum up the handler time of the last interval per CPU. */
+static void irq_balance_collect(void)
+{
+	struct irq_desc *desc;
+	unsigned int cpu;
+	u64 delta;
+	int irq;
+
+	memset(irq_balance_load, 0, nr_cpu_ids * sizeof(*irq_balance_load));
+
+	for_each_active_irq(irq) {
+		desc = irq_to_desc(irq);
+		if (!desc)
+			continue;
+
+		raw_spin_lock_irq(&desc->lock);
+		delta = desc->balance_time - desc->balance_time_last;
+		desc->balance_time_last = desc->balance_time;
+		desc->balance_delta = delta;
+		cpu = desc->balance_cpu;
+		raw_spin_unlock_irq(&desc->lock);
+
+		if (delta && cpu < nr_cpu_ids)
+			irq_balance_load[cpu] += delta;
+	}
+}
+
+/*
+ * Move the heaviest interrupt of the busiest CPU, provided that doing so
+ * actually reduces the imbalance.  Returns false if nothing was moved.
+ */
+static bool irq_balance_one(u64 threshold)
+{
+	struct irq_desc *desc, *best_desc = NULL;
+	unsigned int cpu, busiest = nr_cpu_ids, target, best_target = 0;
+	u64 best_delta = 0;
+	int irq;
+
+	for_each_online_cpu(cpu)
+		if (busiest >= nr_cpu_ids ||
+		    irq_balance_load[cpu] > irq_balance_load[busiest])
+			busiest = cpu;
+	if (busiest >= nr_cpu_ids || irq_balance_load[busiest] < threshold)
+		return false;
+
+	for_each_active_irq(irq) {
+		desc = irq_to_desc(irq);
+		if (!desc || desc->balance_cpu != busiest ||
+		    desc->balance_delta <= best_delta ||
+		    !irq_balance_movable(desc))
+			continue;
+
+		irq_balance_get_candidates(desc);
+		target = nr_cpu_ids;
+		for_each_cpu(cpu, irq_balance_candidates)
+			if (target >= nr_cpu_ids ||
+			    irq_balance_load[cpu] < irq_balance_load[target])
+				target = cpu;
+
+		/* Only move if the target ends up less loaded than we are. */
+		if (target >= nr_cpu_ids || target == busiest ||
+		    irq_balance_load[target] + desc->balance_delta >=
+		    irq_balance_load[busiest])
+			continue;
+
+		best_desc = desc;
+		best_delta = desc->balance_delta;
+		best_target = target;
+	}
+
+	if (!best_desc)
+		return false;
+
+	irq = irq_desc_get_irq(best_desc);
+	if (irq_set_affinity(irq, cpumask_of(best_target)))
+		return false;
+
+	raw_spin_lock_irq(&best_desc->lock);
+	best_desc->balance_owned = true;
+	best_desc->balance_target = best_target;
+	best_desc->balance_cpu = best_target;
+	raw_spin_unlock_irq(&best_desc->lock);
+
+	pr_debug("irqbalance: moved irq %d from CPU%u to CPU%u\n",
+		 irq, busiest, best_target);
+
+	irq_balance_load[busiest] -= best_delta;
+	irq_balance_load[best_target] += best_delta;
+	return true;
+}
+
+static void irq_balance_work_fn(struct work_struct *work)
+{
+	u64 threshold = (u64)interval_ms * NSEC_PER_MSEC * threshold_pct / 100;
+	unsigned int moves;
+
+	irq_lock_sparse();
+	irq_balance_collect();
+	for (moves = 0; moves < max_moves; moves++)
+		if (!irq_balance_one(threshold))
+			break;
+	irq_unlock_sparse();
+
+	if (static_branch_unlikely(&irq_balance_enabled))
+		irq_balance_schedule();
+}
+
+/* Must be called with irq_balance_mutex held. */
+static void irq_balance_start_stop(bool enable)
+{
+	if (enable == static_key_enabled(&irq_balance_enabled))
+		return;
+
+	if (enable) {
+		static_branch_enable(&irq_balance_enabled);
+		irq_balance_schedule();
+	} else {
+		static_branch_disable(&irq_balance_enabled);
+		cancel_delayed_work_sync(&irq_balance_work);
+	}
+}
+
+static int irq_balance_param_set(const char *val,
+				 const struct kernel_param *kp)
+{
+	bool enable;
+	int ret;
+
+	ret = strtobool(val, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&irq_balance_mutex);
+	irq_balance_requested = enable;
+	if (irq_balance_ready)
+		irq_balance_start_stop(enable);
+	mutex_unlock(&irq_balance_mutex);
+	return 0;
+}
+
+static int irq_balance_param_get(char *buffer, const struct kernel_param *kp)
+{
+	return sprintf(buffer, "%c\n", irq_balance_requested ? 'Y' : 'N');
+}
+
+static const struct kernel_param_ops irq_balance_enable_ops = {
+	.set = irq_balance_param_set,
+	.get = irq_balance_param_get,
+};
+module_param_cb(enable, &irq_balance_enable_ops, NULL, 0644);
+
+static int __init irq_balance_init(void)
+{
+	irq_balance_load = kcalloc(nr_cpu_ids, sizeof(*irq_balance_load),
+				   GFP_KERNEL);
+	if (!irq_balance_load)
+		return -ENOMEM;
+	if (!zalloc_cpumask_var(&irq_balance_candidates, GFP_KERNEL)) {
+		kfree(irq_balance_load);
+		return -ENOMEM;
+	}
+
+	mutex_lock(&irq_balance_mutex);
+	irq_balance_ready = true;
+	irq_balance_start_stop(irq_balance_requested);
+	mutex_unlock(&irq_balance_mutex);
+	return 0;
+}
+late_initcall(irq_balance_init);
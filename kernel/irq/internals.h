@@ -36,6 +36,28 @@ enum {
 	IRQTF_FORCED_THREAD,
 };
 
+/*
+ * Polling state of an IRQF_THREAD_POLL action. The statistics are only
+ * written by the irq thread; readers in procfs may see torn snapshots.
+ *
+ * @budget:	maximum number of thread function calls per batch
+ * @batches:	number of batches run by the thread
+ * @polls:	total number of thread function calls
+ * @exhausted:	batches which ended with work still pending
+ * @hist:	batch size histogram, bucket n counts batches of
+ *		(2^(n-1), 2^n] calls, the last bucket everything above
+ */
+#define IRQ_THREAD_POLL_BUDGET		64
+#define IRQ_THREAD_POLL_HIST		8
+
+struct irq_thread_poll {
+	unsigned int		budget;
+	unsigned long		batches;
+	unsigned long		polls;
+	unsigned long		exhausted;
+	unsigned long		hist[IRQ_THREAD_POLL_HIST];
+};
+
 /*
  * Bit masks for desc->core_internal_state__do_not_mess_with_it
  *
@@ -364,6 +386,45 @@ static inline void record_irq_time(struct irq_desc *desc) {}
 #endif /* CONFIG_IRQ_TIMINGS */
 
 
+#ifdef CONFIG_IRQ_BALANCE
+DECLARE_STATIC_KEY_FALSE(irq_balance_enabled);
+
+static __always_inline u64 irq_balance_start(void)
+{
+	if (!static_branch_unlikely(&irq_balance_enabled))
+		return 0;
+	return local_clock();
+}
+
+/*
+ * Account the time spent in the handlers of a non per-CPU interrupt for
+ * the in-kernel balancer.  Called with desc->lock held.
+ */
+static __always_inline void irq_balance_account(struct irq_desc *desc,
+						u64 start)
+{
+	if (!static_branch_unlikely(&irq_balance_enabled) || !start)
+		return;
+
+	desc->balance_time += local_clock() - start;
+	desc->balance_cpu = smp_processor_id();
+}
+
+static inline void irq_balance_reset(struct irq_desc *desc)
+{
+	desc->balance_time = 0;
+	desc->balance_time_last = 0;
+	desc->balance_delta = 0;
+	desc->balance_cpu = 0;
+	desc->balance_target = 0;
+	desc->balance_owned = false;
+}
+#else
+static inline u64 irq_balance_start(void) { return 0; }
+static inline void irq_balance_account(struct irq_desc *desc, u64 start) { }
+static inline void irq_balance_reset(struct irq_desc *desc) { }
+#endif /* CONFIG_IRQ_BALANCE */
+
 #ifdef CONFIG_GENERIC_IRQ_CHIP
 void irq_init_generic_chip(struct irq_chip_generic *gc, const char *name,
 			   int num_ct, unsigned int irq_base,
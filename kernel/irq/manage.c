@@ -875,6 +875,79 @@ static irqreturn_t irq_thread_fn(struct irq_desc *desc,
 	return ret;
 }
 
+/*
+ * Threaded handlers requested with IRQF_THREAD_POLL are polled: the
+ * thread function is called again as long as it reports more pending
+ * work with IRQ_POLL_MORE and the budget is not used up. The line stays
+ * masked (IRQF_ONESHOT) for the whole batch. When the budget runs out
+ * with work still pending, the line is unmasked so other handlers of a
+ * shared line get a chance, and the thread requeues itself so the
+ * pending work is not lost on edge type interrupts.
+ */
+static irqreturn_t irq_thread_poll_fn(struct irq_desc *desc,
+				      struct irqaction *action)
+{
+	struct irq_thread_poll *poll = action->poll;
+	unsigned int budget = READ_ONCE(poll->budget);
+	unsigned int polls = 0;
+	irqreturn_t ret = IRQ_NONE, res;
+
+	do {
+		res = action->thread_fn(action->irq, action->dev_id);
+		ret |= res & ~IRQ_POLL_MORE;
+	} while (++polls < budget && (res & IRQ_POLL_MORE));
+
+	poll->batches++;
+	poll->polls += polls;
+	poll->hist[min(fls(polls - 1), IRQ_THREAD_POLL_HIST - 1)]++;
+
+	irq_finalize_oneshot(desc, action);
+
+	if (res & IRQ_POLL_MORE) {
+		poll->exhausted++;
+		raw_spin_lock_irq(&desc->lock);
+		if (!irqd_irq_disabled(&desc->irq_data))
+			__irq_wake_thread(desc, action);
+		raw_spin_unlock_irq(&desc->lock);
+		cond_resched();
+	}
+	return ret;
+}
+
+/**
+ *	irq_set_thread_poll_budget - set the poll budget of a threaded handler
+ *	@irq:		Interrupt line
+ *	@dev_id:	Device identity of the IRQF_THREAD_POLL action
+ *	@budget:	Maximum number of thread function calls per batch
+ *
+ *	The default budget is IRQ_THREAD_POLL_BUDGET.
+ */
+int irq_set_thread_poll_budget(unsigned int irq, void *dev_id,
+			       unsigned int budget)
+{
+	struct irq_desc *desc = irq_to_desc(irq);
+	struct irqaction *action;
+	unsigned long flags;
+	int ret = -EINVAL;
+
+	if (!desc || !budget)
+		return -EINVAL;
+
+	raw_spin_lock_irqsave(&desc->lock, flags);
+	for_each_action_of_desc(desc, action) {
+		if (action->dev_id == dev_id) {
+			if (action->poll) {
+				WRITE_ONCE(action->poll->budget, budget);
+				ret = 0;
+			}
+			break;
+		}
+	}
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(irq_set_thread_poll_budget);
+
 static void wake_threads_waitq(struct irq_desc *desc)
 {
 	if (atomic_dec_and_test(&desc->threads_active))
@@ -934,6 +1007,8 @@ static int irq_thread(void *data)
 	if (force_irqthreads && test_bit(IRQTF_FORCED_THREAD,
 					&action->thread_flags))
 		handler_fn = irq_forced_thread_fn;
+	else if (action->poll)
+		handler_fn = irq_thread_poll_fn;
 	else
 		handler_fn = irq_thread_fn;
 
@@ -1121,7 +1196,8 @@ __setup_irq(unsigned int irq, struct irq_desc *desc, struct irqaction *new)
 	 */
 	nested = irq_settings_is_nested_thread(desc);
 	if (nested) {
-		if (!new->thread_fn) {
+		/* Nested handlers are called once from the parent thread */
+		if (!new->thread_fn || new->poll) {
 			ret = -EINVAL;
 			goto out_mput;
 		}
@@ -1521,6 +1597,7 @@ static struct irqaction *__free_irq(unsigned int irq, void *dev_id)
 	irq_chip_pm_put(&desc->irq_data);
 	module_put(desc->owner);
 	kfree(action->secondary);
+	kfree(action->poll);
 	return action;
 }
 
@@ -1658,10 +1735,24 @@ int request_threaded_irq(unsigned int irq, irq_handler_t handler,
 		handler = irq_default_primary_handler;
 	}
 
+	/* Polling keeps the line masked, which needs a oneshot thread */
+	if ((irqflags & IRQF_THREAD_POLL) &&
+	    (!thread_fn || !(irqflags & IRQF_ONESHOT)))
+		return -EINVAL;
+
 	action = kzalloc(sizeof(struct irqaction), GFP_KERNEL);
 	if (!action)
 		return -ENOMEM;
 
+	if (irqflags & IRQF_THREAD_POLL) {
+		action->poll = kzalloc(sizeof(*action->poll), GFP_KERNEL);
+		if (!action->poll) {
+			kfree(action);
+			return -ENOMEM;
+		}
+		action->poll->budget = IRQ_THREAD_POLL_BUDGET;
+	}
+
 	action->handler = handler;
 	action->thread_fn = thread_fn;
 	action->flags = irqflags;
@@ -1670,6 +1761,7 @@ int request_threaded_irq(unsigned int irq, irq_handler_t handler,
 
 	retval = irq_chip_pm_get(&desc->irq_data);
 	if (retval < 0) {
+		kfree(action->poll);
 		kfree(action);
 		return retval;
 	}
@@ -1681,6 +1773,7 @@ int request_threaded_irq(unsigned int irq, irq_handler_t handler,
 	if (retval) {
 		irq_chip_pm_put(&desc->irq_data);
 		kfree(action->secondary);
+		kfree(action->poll);
 		kfree(action);
 	}
 
@@ -349,6 +349,42 @@ static const struct file_operations irq_spurious_proc_fops = {
 	.release	= single_release,
 };
 
+static int irq_thread_poll_proc_show(struct seq_file *m, void *v)
+{
+	struct irq_desc *desc = irq_to_desc((long) m->private);
+	struct irqaction *action;
+	unsigned long flags;
+	int i;
+
+	raw_spin_lock_irqsave(&desc->lock, flags);
+	for_each_action_of_desc(desc, action) {
+		struct irq_thread_poll *poll = action->poll;
+
+		if (!poll)
+			continue;
+		seq_printf(m, "%s: budget %u batches %lu polls %lu exhausted %lu\n",
+			   action->name ? action->name : "-", poll->budget,
+			   poll->batches, poll->polls, poll->exhausted);
+		for (i = 0; i < IRQ_THREAD_POLL_HIST - 1; i++)
+			seq_printf(m, "  <=%-4u %lu\n", 1U << i, poll->hist[i]);
+		seq_printf(m, "  >%-5u %lu\n", 1U << (i - 1), poll->hist[i]);
+	}
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+	return 0;
+}
+
+static int irq_thread_poll_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, irq_thread_poll_proc_show, PDE_DATA(inode));
+}
+
+static const struct file_operations irq_thread_poll_proc_fops = {
+	.open		= irq_thread_poll_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 #define MAX_NAMELEN 128
 
 static int name_unique(unsigned int irq, struct irqaction *new_action)
@@ -440,6 +476,10 @@ void register_irq_proc(unsigned int irq, struct irq_desc *desc)
 	proc_create_data("spurious", 0444, desc->dir,
 			 &irq_spurious_proc_fops, (void *)(long)irq);
 
+	/* create /proc/irq/<irq>/thread_poll */
+	proc_create_data("thread_poll", 0444, desc->dir,
+			 &irq_thread_poll_proc_fops, (void *)(long)irq);
+
 out_unlock:
 	mutex_unlock(&register_lock);
 }
@@ -461,6 +501,7 @@ void unregister_irq_proc(unsigned int irq, struct irq_desc *desc)
 # endif
 #endif
 	remove_proc_entry("spurious", desc->dir);
+	remove_proc_entry("thread_poll", desc->dir);
 
 	sprintf(name, "%u", irq);
 	remove_proc_entry(name, root_irq_dir);
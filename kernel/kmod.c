@@ -41,6 +41,7 @@
 #include <linux/rwsem.h>
 #include <linux/ptrace.h>
 #include <linux/async.h>
+#include <linux/initrd.h>
 #include <linux/uaccess.h>
 
 #include <trace/events/module.h>
@@ -251,6 +252,8 @@ static int call_usermodehelper_exec_async(void *data)
 
 	commit_creds(new);
 
+	/* The helper binary may live in an initramfs still being unpacked. */
+	wait_for_initramfs();
 	retval = do_execve(getname_kernel(sub_info->path),
 			   (const char __user *const __user *)sub_info->argv,
 			   (const char __user *const __user *)sub_info->envp);
@@ -32,6 +32,7 @@
 #include <linux/ctype.h>
 #include <linux/genhd.h>
 #include <linux/ktime.h>
+#include <linux/crypto.h>
 #include <trace/events/power.h>
 
 #include "power.h"
@@ -43,6 +44,8 @@ static int nohibernate;
 static int resume_wait;
 static unsigned int resume_delay;
 static char resume_file[256] = CONFIG_PM_STD_PARTITION;
+/* Crypto API compression algorithm used for the image, "lzo" or "lz4". */
+char hib_comp_algo[CRYPTO_MAX_ALG_NAME] = CONFIG_HIBERNATION_DEF_COMP;
 dev_t swsusp_resume_device;
 sector_t swsusp_resume_block;
 __visible int in_suspend __nosavedata;
@@ -685,6 +688,15 @@ int hibernate(void)
 		return -EPERM;
 	}
 
+	/*
+	 * The compressor cannot be autoloaded once tasks are frozen, so make
+	 * sure it is available (loading its module if need be) right now.
+	 */
+	if (!nocompress && !crypto_has_comp(hib_comp_algo, 0, 0)) {
+		pr_err("%s compressor not available\n", hib_comp_algo);
+		return -ENOENT;
+	}
+
 	lock_system_sleep();
 	/* The snapshot device should not be opened while we're running */
 	if (!atomic_add_unless(&snapshot_device_available, -1, 0)) {
@@ -722,10 +734,13 @@ int hibernate(void)
 
 		if (hibernation_mode == HIBERNATION_PLATFORM)
 			flags |= SF_PLATFORM_MODE;
-		if (nocompress)
+		if (nocompress) {
 			flags |= SF_NOCOMPRESS_MODE;
-		else
+		} else {
 		        flags |= SF_CRC32_MODE;
+			if (!strcmp(hib_comp_algo, "lz4"))
+				flags |= SF_COMPRESSION_ALG_LZ4;
+		}
 
 		pr_debug("Writing image.\n");
 		error = swsusp_write(flags);
@@ -1159,6 +1174,17 @@ static int __init hibernate_setup(char *str)
 	return 1;
 }
 
+static int __init hibernate_compressor_setup(char *str)
+{
+	/* The image header can only record these two algorithms. */
+	if (!strcmp(str, "lzo") || !strcmp(str, "lz4"))
+		strlcpy(hib_comp_algo, str, sizeof(hib_comp_algo));
+	else
+		pr_warn("Unsupported compressor %s, using %s\n",
+			str, hib_comp_algo);
+	return 1;
+}
+
 static int __init noresume_setup(char *str)
 {
 	noresume = 1;
@@ -1191,6 +1217,7 @@ __setup("noresume", noresume_setup);
 __setup("resume_offset=", resume_offset_setup);
 __setup("resume=", resume_setup);
 __setup("hibernate=", hibernate_setup);
+__setup("hibernate_compressor=", hibernate_compressor_setup);
 __setup("resumewait", resumewait_setup);
 __setup("resumedelay=", resumedelay_setup);
 __setup("nohibernate", nohibernate_setup);
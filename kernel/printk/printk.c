@@ -42,6 +42,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/utsname.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
@@ -1692,12 +1693,23 @@ static size_t log_output(int facility, int level, enum log_flags lflags, const c
 	return log_store(facility, level, lflags, 0, dict, dictlen, text, text_len);
 }
 
+/*
+ * Per-CPU staging buffer used to format messages before they are copied
+ * into the log buffer.  Formatting runs in printk-safe context with
+ * interrupts disabled, so any nested printk() on this CPU (recursion or
+ * NMI) is redirected to the printk-safe buffers and cannot clobber it.
+ * This keeps vscnprintf() out of the logbuf_lock critical section.
+ */
+static DEFINE_PER_CPU(char [LOG_LINE_MAX], printk_textbuf);
+
+static void defer_console_output(void);
+static bool printk_offload_console(int level);
+
 asmlinkage int vprintk_emit(int facility, int level,
 			    const char *dict, size_t dictlen,
 			    const char *fmt, va_list args)
 {
-	static char textbuf[LOG_LINE_MAX];
-	char *text = textbuf;
+	char *text;
 	size_t text_len = 0;
 	enum log_flags lflags = 0;
 	unsigned long flags;
@@ -1712,13 +1724,13 @@ asmlinkage int vprintk_emit(int facility, int level,
 	boot_delay_msec(level);
 	printk_delay();
 
-	/* This stops the holder of console_sem just where we want him */
-	logbuf_lock_irqsave(flags);
+	printk_safe_enter_irqsave(flags);
+	text = this_cpu_ptr(printk_textbuf);
 	/*
 	 * The printf needs to come first; we need the syslog
 	 * prefix which might be passed-in as a parameter.
 	 */
-	text_len = vscnprintf(text, sizeof(textbuf), fmt, args);
+	text_len = vscnprintf(text, LOG_LINE_MAX, fmt, args);
 
 	/* mark and strip a trailing newline */
 	if (text_len && text[text_len-1] == '\n') {
@@ -1754,18 +1766,26 @@ asmlinkage int vprintk_emit(int facility, int level,
 	if (dict)
 		lflags |= LOG_PREFIX|LOG_NEWLINE;
 
+	/* This stops the holder of console_sem just where we want him */
+	raw_spin_lock(&logbuf_lock);
 	printed_len += log_output(facility, level, lflags, dict, dictlen, text, text_len);
-
-	logbuf_unlock_irqrestore(flags);
+	raw_spin_unlock(&logbuf_lock);
+	printk_safe_exit_irqrestore(flags);
 
 	/* If called from the scheduler, we can not call up(). */
 	if (!in_sched) {
+		/*
+		 * Leave the printing to the printk kthread when possible so
+		 * that the caller does not have to wait for slow consoles.
+		 */
+		if (printk_offload_console(level))
+			defer_console_output();
 		/*
 		 * Try to acquire and then immediately release the console
 		 * semaphore.  The release will print out buffers and wake up
 		 * /dev/kmsg and syslog() users.
 		 */
-		if (console_trylock())
+		else if (console_trylock())
 			console_unlock();
 	}
 
@@ -2691,14 +2711,105 @@ late_initcall(printk_late_init);
 
 static DEFINE_PER_CPU(int, printk_pending);
 
+/*
+ * Unless disabled with printk.offload=0, printk() callers only store their
+ * messages in the log buffer and a dedicated kthread prints them to the
+ * consoles, so that the caller does not wait for slow consoles.  Storing
+ * the message still serializes on logbuf_lock.  Messages are printed
+ * directly while the system is booting or going down, during oops and for
+ * KERN_EMERG messages, when getting them out is more important than
+ * latency.
+ */
+static bool printk_offload = true;
+module_param_named(offload, printk_offload, bool, S_IRUGO | S_IWUSR);
+
+/*
+ * If the printk kthread has not picked up a flush request after this long,
+ * for example because an RT task or a soft lockup keeps it off the CPU,
+ * printk() callers go back to printing directly until it catches up.
+ */
+#define PRINTK_KTHREAD_STALL_MS	500
+
+static struct task_struct *printk_kthread;
+static DECLARE_WAIT_QUEUE_HEAD(printk_kthread_wait);
+static bool printk_kthread_need_flush;
+static unsigned long printk_kthread_flush_stamp;
+
+static bool printk_kthread_stalled(void)
+{
+	if (!smp_load_acquire(&printk_kthread_need_flush))
+		return false;
+
+	return time_after(jiffies, READ_ONCE(printk_kthread_flush_stamp) +
+			  msecs_to_jiffies(PRINTK_KTHREAD_STALL_MS));
+}
+
+static bool printk_offload_console(int level)
+{
+	return READ_ONCE(printk_offload) && READ_ONCE(printk_kthread) &&
+	       !oops_in_progress && system_state == SYSTEM_RUNNING &&
+	       level > LOGLEVEL_EMERG && !printk_kthread_stalled();
+}
+
+static void printk_kthread_wake(void)
+{
+	if (!READ_ONCE(printk_kthread_need_flush)) {
+		WRITE_ONCE(printk_kthread_flush_stamp, jiffies);
+		/* Publish the stamp before the request it belongs to. */
+		smp_store_release(&printk_kthread_need_flush, true);
+	}
+	wake_up_interruptible(&printk_kthread_wait);
+}
+
+static int printk_kthread_func(void *data)
+{
+	for (;;) {
+		wait_event_interruptible(printk_kthread_wait,
+					 READ_ONCE(printk_kthread_need_flush));
+		WRITE_ONCE(printk_kthread_need_flush, false);
+
+		/*
+		 * Print with preemption disabled, like a direct printk()
+		 * caller.  If the kthread could be preempted while holding
+		 * console_sem, the stall fallback above would fail to get it.
+		 * If console_trylock() fails, the owner prints the new records
+		 * itself when it calls console_unlock().
+		 */
+		preempt_disable();
+		if (console_trylock())
+			console_unlock();
+		preempt_enable();
+	}
+
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *thread;
+
+	thread = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(thread)) {
+		pr_err("printk: unable to create printing thread\n");
+		return PTR_ERR(thread);
+	}
+
+	WRITE_ONCE(printk_kthread, thread);
+	return 0;
+}
+late_initcall(printk_kthread_init);
+
 static void wake_up_klogd_work_func(struct irq_work *irq_work)
 {
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
-		/* If trylock fails, someone else is doing the printing */
-		if (console_trylock())
+		if (printk_offload_console(LOGLEVEL_DEFAULT)) {
+			printk_kthread_wake();
+		} else if (console_trylock()) {
+			/* If trylock fails, someone else is doing the printing */
 			console_unlock();
+		}
 	}
 
 	if (pending & PRINTK_PENDING_WAKEUP)
@@ -2720,16 +2831,20 @@ void wake_up_klogd(void)
 	preempt_enable();
 }
 
-int vprintk_deferred(const char *fmt, va_list args)
+static void defer_console_output(void)
 {
-	int r;
-
-	r = vprintk_emit(0, LOGLEVEL_SCHED, NULL, 0, fmt, args);
-
 	preempt_disable();
 	__this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
 	irq_work_queue(this_cpu_ptr(&wake_up_klogd_work));
 	preempt_enable();
+}
+
+int vprintk_deferred(const char *fmt, va_list args)
+{
+	int r;
+
+	r = vprintk_emit(0, LOGLEVEL_SCHED, NULL, 0, fmt, args);
+	defer_console_output();
 
 	return r;
 }
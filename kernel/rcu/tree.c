@@ -58,6 +58,9 @@
 #include <linux/trace_events.h>
 #include <linux/suspend.h>
 #include <linux/ftrace.h>
+#include <linux/slab.h>
+#include <linux/gfp.h>
+#include <linux/workqueue.h>
 
 #include "tree.h"
 #include "rcu.h"
@@ -3226,19 +3229,329 @@ void call_rcu_bh(struct rcu_head *head, rcu_callback_t func)
 EXPORT_SYMBOL_GPL(call_rcu_bh);
 
 /*
- * Queue an RCU callback for lazy invocation after a grace period.
- * This will likely be later named something like "call_rcu_lazy()",
- * but this change will require some way of tagging the lazy RCU
- * callbacks in the list of pending callbacks. Until then, this
- * function may only be called from __kfree_rcu().
+ * Maximum number of jiffies that kfree_rcu() pointers are allowed to
+ * accumulate in a per-CPU batch before that batch is handed to RCU.
+ */
+#define KFREE_DRAIN_JIFFIES (HZ / 50)
+
+/*
+ * Number of batches that may be waiting for a grace period at the same
+ * time on a given CPU.  While all of them are in flight, newly queued
+ * pointers simply keep accumulating until one of the batches completes.
+ */
+#define KFREE_N_BATCHES 2
+
+/**
+ * struct kfree_rcu_bulk_data - single block to store kfree_rcu() pointers
+ * @nr_records: Number of active pointers in the array
+ * @next: Next bulk object in the block chain
+ * @records: Array of the kfree_rcu() pointers
+ *
+ * Each block occupies exactly one page, so that kfree_rcu() can gather
+ * objects without touching their (likely cache-cold) rcu_head structures
+ * and then hand entire arrays to kfree_bulk() after the grace period.
+ */
+struct kfree_rcu_bulk_data {
+	unsigned long nr_records;
+	struct kfree_rcu_bulk_data *next;
+	void *records[];
+};
+
+#define KFREE_BULK_MAX_ENTR \
+	((PAGE_SIZE - sizeof(struct kfree_rcu_bulk_data)) / sizeof(void *))
+
+/**
+ * struct kfree_rcu_cpu_work - single batch of kfree_rcu() requests
+ * @rcu: RCU callback used to wait for the batch's grace period
+ * @work: Work item that frees the batch in process context
+ * @bhead_free: Chain of blocks waiting for (or past) a grace period
+ * @krcp: Pointer to the owning kfree_rcu_cpu structure
+ */
+struct kfree_rcu_cpu_work {
+	struct rcu_head rcu;
+	struct work_struct work;
+	struct kfree_rcu_bulk_data *bhead_free;
+	struct kfree_rcu_cpu *krcp;
+};
+
+/**
+ * struct kfree_rcu_cpu - batch up kfree_rcu() requests for RCU grace period
+ * @bhead: Chain of blocks accumulating pointers for the next batch
+ * @krw_arr: Array of batches waiting for a grace period
+ * @lock: Synchronize access to this structure
+ * @monitor_work: Delayed work that hands @bhead to a free batch
+ * @monitor_todo: True if @monitor_work is scheduled
+ *
+ * This is a per-CPU structure.  The reason that it is not included in
+ * the rcu_data structure is to permit this code to be extracted from
+ * the RCU files.  Such extraction could allow further optimization of
+ * the interactions with the slab allocators.
+ */
+struct kfree_rcu_cpu {
+	struct kfree_rcu_bulk_data *bhead;
+	struct kfree_rcu_cpu_work krw_arr[KFREE_N_BATCHES];
+	spinlock_t lock;
+	struct delayed_work monitor_work;
+	bool monitor_todo;
+};
+
+static DEFINE_PER_CPU(struct kfree_rcu_cpu, krc);
+
+/* Free a chain of blocks whose grace period has elapsed. */
+static void kfree_rcu_free_blocks(struct kfree_rcu_bulk_data *bhead)
+{
+	struct kfree_rcu_bulk_data *bnext;
+
+	for (; bhead; bhead = bnext) {
+		bnext = bhead->next;
+
+		rcu_lock_acquire(&rcu_callback_map);
+		kfree_bulk(bhead->nr_records, bhead->records);
+		rcu_lock_release(&rcu_callback_map);
+
+		free_page((unsigned long)bhead);
+		cond_resched_rcu_qs();
+	}
+}
+
+/*
+ * Free every block in a batch whose grace period has elapsed.  This runs
+ * from a workqueue rather than from the RCU callback itself, so that a
+ * large batch does not lengthen softirq processing.
+ */
+static void kfree_rcu_work(struct work_struct *work)
+{
+	unsigned long flags;
+	struct kfree_rcu_bulk_data *bhead;
+	struct kfree_rcu_cpu_work *krwp;
+	struct kfree_rcu_cpu *krcp;
+
+	krwp = container_of(work, struct kfree_rcu_cpu_work, work);
+	krcp = krwp->krcp;
+	spin_lock_irqsave(&krcp->lock, flags);
+	bhead = krwp->bhead_free;
+	krwp->bhead_free = NULL;
+	spin_unlock_irqrestore(&krcp->lock, flags);
+
+	kfree_rcu_free_blocks(bhead);
+}
+
+/*
+ * RCU callback marking the end of a batch's grace period.  Defer the
+ * actual freeing to process context.
+ */
+static void kfree_rcu_work_rcu_cb(struct rcu_head *rhp)
+{
+	struct kfree_rcu_cpu_work *krwp;
+
+	krwp = container_of(rhp, struct kfree_rcu_cpu_work, rcu);
+	queue_work(system_wq, &krwp->work);
+}
+
+/*
+ * Attempt to hand the blocks accumulated in ->bhead to a batch that is
+ * not already waiting for a grace period.  Returns false if every batch
+ * is busy, in which case the caller must try again later.
+ */
+static bool queue_kfree_rcu_work(struct kfree_rcu_cpu *krcp)
+{
+	struct kfree_rcu_cpu_work *krwp;
+	int i;
+
+	lockdep_assert_held(&krcp->lock);
+	if (!krcp->bhead)
+		return true;
+
+	for (i = 0; i < KFREE_N_BATCHES; i++) {
+		krwp = &krcp->krw_arr[i];
+		if (krwp->bhead_free)
+			continue;
+
+		krwp->bhead_free = krcp->bhead;
+		krcp->bhead = NULL;
+		__call_rcu(&krwp->rcu, kfree_rcu_work_rcu_cb, rcu_state_p,
+			   -1, 0);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Hand the current batch to RCU if possible, otherwise re-arm the
+ * monitor.  Drops ->lock, which the caller must hold.
+ */
+static void kfree_rcu_drain_unlock(struct kfree_rcu_cpu *krcp,
+				   unsigned long flags)
+{
+	if (queue_kfree_rcu_work(krcp)) {
+		krcp->monitor_todo = false;
+		spin_unlock_irqrestore(&krcp->lock, flags);
+		return;
+	}
+
+	/* Previous batches still in flight, try again later. */
+	schedule_delayed_work(&krcp->monitor_work, KFREE_DRAIN_JIFFIES);
+	spin_unlock_irqrestore(&krcp->lock, flags);
+}
+
+/*
+ * Periodically drain the per-CPU pointer arrays so that kfree_rcu()
+ * requests are not delayed indefinitely on a lightly loaded CPU.
+ */
+static void kfree_rcu_monitor(struct work_struct *work)
+{
+	unsigned long flags;
+	struct kfree_rcu_cpu *krcp = container_of(work, struct kfree_rcu_cpu,
+						  monitor_work.work);
+
+	spin_lock_irqsave(&krcp->lock, flags);
+	if (krcp->monitor_todo)
+		kfree_rcu_drain_unlock(krcp, flags);
+	else
+		spin_unlock_irqrestore(&krcp->lock, flags);
+}
+
+/*
+ * Make the rcu_barrier() in progress cover batched kfree_rcu() requests.
+ * Each CPU's accumulated blocks are handed to a batch, whose RCU callback
+ * the barrier then waits for.  Blocks that find every batch of their CPU
+ * already in flight are detached and freed here after a grace period of
+ * their own.
+ */
+static void kfree_rcu_barrier_start(void)
+{
+	struct kfree_rcu_bulk_data *bhead, *bnext, *detached = NULL;
+	struct kfree_rcu_cpu *krcp;
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		krcp = per_cpu_ptr(&krc, cpu);
+		spin_lock_irqsave(&krcp->lock, flags);
+		if (!queue_kfree_rcu_work(krcp)) {
+			for (bhead = krcp->bhead; bhead; bhead = bnext) {
+				bnext = bhead->next;
+				bhead->next = detached;
+				detached = bhead;
+			}
+			krcp->bhead = NULL;
+		}
+		spin_unlock_irqrestore(&krcp->lock, flags);
+	}
+
+	if (detached) {
+		synchronize_rcu();
+		kfree_rcu_free_blocks(detached);
+	}
+}
+
+/*
+ * The barrier has invoked every batch's RCU callback, which only queues
+ * the work that does the freeing, so wait for that work as well.
+ */
+static void kfree_rcu_barrier_finish(void)
+{
+	int cpu;
+	int i;
+
+	for_each_possible_cpu(cpu) {
+		struct kfree_rcu_cpu *krcp = per_cpu_ptr(&krc, cpu);
+
+		for (i = 0; i < KFREE_N_BATCHES; i++)
+			flush_work(&krcp->krw_arr[i].work);
+	}
+}
+
+/*
+ * Record the object in the current per-CPU block, allocating a new
+ * block if needed.  Returns false if no block could be allocated, in
+ * which case the caller falls back to the rcu_head embedded in the
+ * object.
+ */
+static bool kfree_call_rcu_add_ptr_to_bulk(struct kfree_rcu_cpu *krcp,
+					   struct rcu_head *head,
+					   rcu_callback_t func)
+{
+	struct kfree_rcu_bulk_data *bnode;
+
+	if (!krcp->bhead || krcp->bhead->nr_records == KFREE_BULK_MAX_ENTR) {
+		bnode = (struct kfree_rcu_bulk_data *)
+			__get_free_page(GFP_NOWAIT | __GFP_NOWARN);
+		if (!bnode)
+			return false;
+
+		bnode->nr_records = 0;
+		bnode->next = krcp->bhead;
+		krcp->bhead = bnode;
+	}
+
+	krcp->bhead->records[krcp->bhead->nr_records++] =
+		(void *)head - (unsigned long)func;
+	return true;
+}
+
+/*
+ * Queue a request for lazy invocation of kfree() after a grace period.
+ *
+ * Each kfree_call_rcu() request is added to a per-CPU page-sized array
+ * of pointers.  After KFREE_DRAIN_JIFFIES, or when the monitor next
+ * runs, the accumulated arrays are handed to RCU as a single batch, and
+ * once its grace period has elapsed the pointers are released with
+ * kfree_bulk().  This avoids queueing (and later invoking) one RCU
+ * callback per object.  If no array page can be allocated, or if the
+ * scheduler is not yet fully running, the request instead goes through
+ * the normal callback path using the object's own rcu_head.
+ *
+ * This function may only be called from __kfree_rcu().
  */
 void kfree_call_rcu(struct rcu_head *head,
 		    rcu_callback_t func)
 {
-	__call_rcu(head, func, rcu_state_p, -1, 1);
+	unsigned long flags;
+	struct kfree_rcu_cpu *krcp;
+
+	if (rcu_scheduler_active != RCU_SCHEDULER_RUNNING) {
+		__call_rcu(head, func, rcu_state_p, -1, 1);
+		return;
+	}
+
+	local_irq_save(flags);	/* For safely calling this_cpu_ptr(). */
+	krcp = this_cpu_ptr(&krc);
+	spin_lock(&krcp->lock);
+
+	if (!kfree_call_rcu_add_ptr_to_bulk(krcp, head, func)) {
+		spin_unlock_irqrestore(&krcp->lock, flags);
+		__call_rcu(head, func, rcu_state_p, -1, 1);
+		return;
+	}
+
+	/* Set timer to drain after KFREE_DRAIN_JIFFIES. */
+	if (!krcp->monitor_todo) {
+		krcp->monitor_todo = true;
+		schedule_delayed_work(&krcp->monitor_work,
+				      KFREE_DRAIN_JIFFIES);
+	}
+	spin_unlock_irqrestore(&krcp->lock, flags);
 }
 EXPORT_SYMBOL_GPL(kfree_call_rcu);
 
+static void __init kfree_rcu_batch_init(void)
+{
+	int cpu;
+	int i;
+
+	for_each_possible_cpu(cpu) {
+		struct kfree_rcu_cpu *krcp = per_cpu_ptr(&krc, cpu);
+
+		spin_lock_init(&krcp->lock);
+		for (i = 0; i < KFREE_N_BATCHES; i++) {
+			INIT_WORK(&krcp->krw_arr[i].work, kfree_rcu_work);
+			krcp->krw_arr[i].krcp = krcp;
+		}
+		INIT_DELAYED_WORK(&krcp->monitor_work, kfree_rcu_monitor);
+	}
+}
+
 /*
  * Because a context switch is a grace period for RCU-sched and RCU-bh,
  * any blocking grace-period wait automatically implies a grace period
@@ -3622,6 +3935,10 @@ static void _rcu_barrier(struct rcu_state *rsp)
 	rcu_seq_start(&rsp->barrier_sequence);
 	_rcu_barrier_trace(rsp, "Inc1", -1, rsp->barrier_sequence);
 
+	/* Batched kfree_rcu() requests wait on rcu_state_p. */
+	if (rsp == rcu_state_p)
+		kfree_rcu_barrier_start();
+
 	/*
 	 * Initialize the count to one rather than to zero in order to
 	 * avoid a too-soon return to zero in case of a short grace period
@@ -3674,6 +3991,9 @@ static void _rcu_barrier(struct rcu_state *rsp)
 	/* Wait for all rcu_barrier_callback() callbacks to be invoked. */
 	wait_for_completion(&rsp->barrier_completion);
 
+	if (rsp == rcu_state_p)
+		kfree_rcu_barrier_finish();
+
 	/* Mark the end of the barrier operation. */
 	_rcu_barrier_trace(rsp, "Inc2", -1, rsp->barrier_sequence);
 	rcu_seq_end(&rsp->barrier_sequence);
@@ -4213,6 +4533,7 @@ void __init rcu_init(void)
 
 	rcu_early_boot_tests();
 
+	kfree_rcu_batch_init();
 	rcu_bootup_announce();
 	rcu_init_geometry();
 	rcu_init_one(&rcu_bh_state);
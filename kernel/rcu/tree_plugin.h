@@ -2241,15 +2241,14 @@ static void do_nocb_deferred_wakeup(struct rcu_data *rdp)
 void __init rcu_init_nohz(void)
 {
 	int cpu;
-	bool need_rcu_nocb_mask = true;
 	struct rcu_state *rsp;
 
-#if defined(CONFIG_NO_HZ_FULL)
-	if (tick_nohz_full_running && cpumask_weight(tick_nohz_full_mask))
-		need_rcu_nocb_mask = true;
-#endif /* #if defined(CONFIG_NO_HZ_FULL) */
-
-	if (!have_rcu_nocb_mask && need_rcu_nocb_mask) {
+	/*
+	 * Allocate rcu_nocb_mask even if no CPU is offloaded at boot, so
+	 * that CPUs can still be offloaded at runtime via the
+	 * rcutree.nocb_cpus parameter.
+	 */
+	if (!have_rcu_nocb_mask) {
 		if (!zalloc_cpumask_var(&rcu_nocb_mask, GFP_KERNEL)) {
 			pr_info("rcu_nocb_mask allocation failed, callback offloading disabled.\n");
 			return;
@@ -2295,6 +2294,8 @@ static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
  * brought online out of order, this can require re-organizing the
  * leader-follower relationships.
  */
+static void rcu_nocb_kthread_affine(struct task_struct *t);
+
 static void rcu_spawn_one_nocb_kthread(struct rcu_state *rsp, int cpu)
 {
 	struct rcu_data *rdp;
@@ -2334,6 +2335,7 @@ static void rcu_spawn_one_nocb_kthread(struct rcu_state *rsp, int cpu)
 	t = kthread_run(rcu_nocb_kthread, rdp_spawn,
 			"rcuo%c/%d", rsp->abbr, cpu);
 	BUG_ON(IS_ERR(t));
+	rcu_nocb_kthread_affine(t);
 	WRITE_ONCE(rdp_spawn->nocb_kthread, t);
 }
 
@@ -2428,6 +2430,217 @@ static bool init_nocb_callback_list(struct rcu_data *rdp)
 	return true;
 }
 
+/*
+ * Run rcuo kthreads on the CPUs that still invoke their own callbacks,
+ * so that offloading actually takes callback processing off the no-CBs
+ * CPUs.  If every CPU is a no-CBs CPU, let them run anywhere.  The
+ * system administrator can of course move these kthreads elsewhere.
+ */
+static void rcu_nocb_kthread_affine(struct task_struct *t)
+{
+	cpumask_var_t cm;
+
+	if (!zalloc_cpumask_var(&cm, GFP_KERNEL))
+		return;
+	cpumask_andnot(cm, cpu_possible_mask, rcu_nocb_mask);
+	if (cpumask_intersects(cm, cpu_active_mask))
+		set_cpus_allowed_ptr(t, cm);
+	else
+		set_cpus_allowed_ptr(t, cpu_possible_mask);
+	free_cpumask_var(cm);
+}
+
+/* Re-apply the affinity above to every rcuo kthread after a mask change. */
+static void rcu_nocb_kthreads_reaffine(void)
+{
+	struct task_struct *t;
+	struct rcu_state *rsp;
+	int cpu;
+
+	for_each_rcu_flavor(rsp) {
+		for_each_cpu(cpu, rcu_nocb_mask) {
+			t = READ_ONCE(per_cpu_ptr(rsp->rda, cpu)->nocb_kthread);
+			if (t)
+				rcu_nocb_kthread_affine(t);
+		}
+	}
+}
+
+/*
+ * Runtime offloading of callbacks.  CPUs may be added to rcu_nocb_mask
+ * after boot by writing a CPU list to /sys/module/rcutree/parameters/
+ * nocb_cpus, for example when a CPU is handed over to a latency-critical
+ * workload.  Offloading is one-way: a CPU cannot be switched back to
+ * invoking its own callbacks without a reboot, and cpuset
+ * reconfiguration does not drive it yet.
+ */
+static DEFINE_MUTEX(rcu_nocb_offload_mutex);
+
+/*
+ * Make the specified CPU's rcu_data a follower of an already-running
+ * leader whose CPU falls into the same rcu_nocb_leader_stride group, or
+ * a leader in its own right if there is no such leader.
+ */
+static void rcu_nocb_join_group(struct rcu_state *rsp, struct rcu_data *rdp)
+{
+	int cpu;
+	int ls = max(rcu_nocb_leader_stride, 1);
+	int first = rdp->cpu - rdp->cpu % ls;
+	struct rcu_data *rdp_leader;
+	struct rcu_data *rdp_tail;
+
+	rdp->nocb_next_follower = NULL;
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		if (cpu < first || cpu == rdp->cpu)
+			continue;
+		if (cpu >= first + ls)
+			break;
+		rdp_leader = per_cpu_ptr(rsp->rda, cpu)->nocb_leader;
+		if (!rdp_leader || !READ_ONCE(rdp_leader->nocb_kthread))
+			continue;
+		rdp->nocb_leader = rdp_leader;
+		for (rdp_tail = rdp_leader;
+		     rdp_tail->nocb_next_follower;
+		     rdp_tail = rdp_tail->nocb_next_follower)
+			continue;
+		/* Initialize ->nocb_leader before the leader can see us. */
+		smp_store_release(&rdp_tail->nocb_next_follower, rdp);
+		return;
+	}
+	rdp->nocb_leader = rdp;
+}
+
+/*
+ * Switch the current CPU's callbacks over to the no-CBs lists.  Runs on
+ * the CPU being offloaded with interrupts disabled, so that neither
+ * __call_rcu() nor rcu_do_batch() can be working on the ->cblist of this
+ * CPU concurrently.  Callbacks that were partway through their grace
+ * period must wait for another one, just as when they are orphaned.
+ */
+static long rcu_nocb_offload_cpu_fn(void *unused)
+{
+	unsigned long flags;
+	struct rcu_cblist rcl;
+	struct rcu_data *rdp;
+	struct rcu_state *rsp;
+
+	local_irq_save(flags);
+	for_each_rcu_flavor(rsp) {
+		rdp = this_cpu_ptr(rsp->rda);
+		rcu_cblist_init(&rcl);
+		rcu_segcblist_extract_count(&rdp->cblist, &rcl);
+		rcu_segcblist_extract_done_cbs(&rdp->cblist, &rcl);
+		rcu_segcblist_extract_pend_cbs(&rdp->cblist, &rcl);
+		rcu_segcblist_disable(&rdp->cblist);
+		if (rcl.head)
+			__call_rcu_nocb_enqueue(rdp, rcl.head, rcl.tail,
+						rcl.len, rcl.len_lazy, flags);
+	}
+	/*
+	 * Only now that ->cblist is empty and disabled may the likes of
+	 * rcu_needs_cpu() and rcu_prepare_for_idle() see a no-CBs CPU.
+	 */
+	cpumask_set_cpu(smp_processor_id(), rcu_nocb_mask);
+	local_irq_restore(flags);
+	return 0;
+}
+
+/*
+ * Offload callback invocation from the specified CPU.  If the CPU is
+ * offline, it is simply marked as a no-CBs CPU and its rcuo kthreads
+ * are spawned when it comes online.
+ */
+static int rcu_nocb_offload_cpu(int cpu)
+{
+	struct rcu_data *rdp;
+	struct rcu_state *rsp;
+	struct task_struct *t;
+	int subclass = 0;
+	int ret = 0;
+
+	/*
+	 * Exclude rcu_barrier(), which treats no-CBs CPUs specially.  Its
+	 * ->barrier_mutex nests outside of the CPU-hotplug lock.
+	 */
+	mutex_lock(&rcu_nocb_offload_mutex);
+	for_each_rcu_flavor(rsp)
+		mutex_lock_nested(&rsp->barrier_mutex, subclass++);
+	get_online_cpus();
+	if (rcu_is_nocb_cpu(cpu))
+		goto out;
+
+	for_each_rcu_flavor(rsp) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		rcu_nocb_join_group(rsp, rdp);
+		if (!cpu_online(cpu) || rdp->nocb_kthread)
+			continue;
+		t = kthread_run(rcu_nocb_kthread, rdp,
+				"rcuo%c/%d", rsp->abbr, cpu);
+		if (IS_ERR(t)) {
+			ret = PTR_ERR(t);
+			goto out;
+		}
+		rcu_nocb_kthread_affine(t);
+		WRITE_ONCE(rdp->nocb_kthread, t);
+	}
+
+	/*
+	 * An online CPU is marked as no-CBs by rcu_nocb_offload_cpu_fn()
+	 * once its callbacks have been moved.  Only then can the rcuo
+	 * kthreads, including the ones just spawned, be moved off it.
+	 */
+	if (cpu_online(cpu))
+		work_on_cpu(cpu, rcu_nocb_offload_cpu_fn, NULL);
+	else
+		cpumask_set_cpu(cpu, rcu_nocb_mask);
+	rcu_nocb_kthreads_reaffine();
+	pr_info("Offloaded RCU callbacks from CPU %d.\n", cpu);
+out:
+	put_online_cpus();
+	for_each_rcu_flavor(rsp)
+		mutex_unlock(&rsp->barrier_mutex);
+	mutex_unlock(&rcu_nocb_offload_mutex);
+	return ret;
+}
+
+static int param_set_nocb_cpus(const char *val, const struct kernel_param *kp)
+{
+	cpumask_var_t cm;
+	int cpu;
+	int ret;
+
+	/* Too early, or rcu_nocb_mask could not be allocated at boot. */
+	if (!rcu_scheduler_fully_active || !have_rcu_nocb_mask)
+		return -EBUSY;
+	if (!alloc_cpumask_var(&cm, GFP_KERNEL))
+		return -ENOMEM;
+	ret = cpulist_parse(val, cm);
+	if (!ret && !cpumask_subset(cm, cpu_possible_mask))
+		ret = -EINVAL;
+	if (!ret && !cpumask_subset(rcu_nocb_mask, cm))
+		ret = -EINVAL;	/* Offloading cannot be undone. */
+	for_each_cpu(cpu, cm) {
+		if (ret)
+			break;
+		ret = rcu_nocb_offload_cpu(cpu);
+	}
+	free_cpumask_var(cm);
+	return ret;
+}
+
+static int param_get_nocb_cpus(char *buffer, const struct kernel_param *kp)
+{
+	if (!have_rcu_nocb_mask)
+		return sprintf(buffer, "\n");
+	return sprintf(buffer, "%*pbl\n", cpumask_pr_args(rcu_nocb_mask));
+}
+
+static const struct kernel_param_ops nocb_cpus_ops = {
+	.set = param_set_nocb_cpus,
+	.get = param_get_nocb_cpus,
+};
+module_param_cb(nocb_cpus, &nocb_cpus_ops, NULL, 0644);
+
 #else /* #ifdef CONFIG_RCU_NOCB_CPU */
 
 static bool rcu_nocb_cpu_needs_barrier(struct rcu_state *rsp, int cpu)
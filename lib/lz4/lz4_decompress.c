@@ -56,14 +56,14 @@ static FORCE_INLINE int LZ4_decompress_generic(
 		/*
 		 * If endOnInput == endOnInputSize,
 		 * this value is the max size of Output Buffer.
+		 * If partialDecoding == partial, decoding stops
+		 * once this many bytes have been written.
 		 */
 	 int outputSize,
 	 /* endOnOutputSize, endOnInputSize */
 	 int endOnInput,
 	 /* full, partial */
 	 int partialDecoding,
-	 /* only used if partialDecoding == partial */
-	 int targetOutputSize,
 	 /* noDict, withPrefix64k, usingExtDict */
 	 int dict,
 	 /* == dest when no prefix */
@@ -81,7 +81,6 @@ static FORCE_INLINE int LZ4_decompress_generic(
 	BYTE *op = (BYTE *) dest;
 	BYTE * const oend = op + outputSize;
 	BYTE *cpy;
-	BYTE *oexit = op + targetOutputSize;
 	const BYTE * const lowLimit = lowPrefix - dictSize;
 
 	const BYTE * const dictEnd = (const BYTE *)dictStart + dictSize;
@@ -91,18 +90,28 @@ static FORCE_INLINE int LZ4_decompress_generic(
 	const int safeDecode = (endOnInput == endOnInputSize);
 	const int checkOffset = ((safeDecode) && (dictSize < (int)(64 * KB)));
 
-	/* Special cases */
-	/* targetOutputSize too high => decode everything */
-	if ((partialDecoding) && (oexit > oend - MFLIMIT))
-		oexit = oend - MFLIMIT;
+	/*
+	 * End pointers for the shortcut below: room for the longest
+	 * literal run (14, or 8 when !endOnInput) and its offset on input,
+	 * and for those literals plus the longest match (18) on output.
+	 */
+	const BYTE * const shortiend = iend - (endOnInput ? 14 : 8) - 2;
+	const BYTE * const shortoend = oend - (endOnInput ? 14 : 8) - 18;
 
 	/* Empty output buffer */
-	if ((endOnInput) && (unlikely(outputSize == 0)))
+	if ((endOnInput) && (unlikely(outputSize == 0))) {
+		/* nothing was requested, the input is left unparsed */
+		if (partialDecoding)
+			return 0;
 		return ((inputSize == 1) && (*ip == 0)) ? 0 : -1;
+	}
 
 	if ((!endOnInput) && (unlikely(outputSize == 0)))
 		return (*ip == 0 ? 1 : -1);
 
+	if ((endOnInput) && unlikely(inputSize == 0))
+		return -1;
+
 	/* Main Loop : decode sequences */
 	while (1) {
 		size_t length;
@@ -114,9 +123,67 @@ static FORCE_INLINE int LZ4_decompress_generic(
 
 		length = token>>ML_BITS;
 
+		/*
+		 * A two-stage shortcut for the most common case:
+		 * 1) If the literal length is 0..14 and there is enough
+		 * space, copy 16 bytes on behalf of the literals (only 8
+		 * bytes are known to be safe when !endOnInput).
+		 * 2) If the match length is then 4..18 and the match
+		 * doesn't overlap its own output, copy 18 bytes for it.
+		 * The space for both stages is checked upfront.
+		 */
+		if ((endOnInput ? length != RUN_MASK : length <= 8)
+			/*
+			 * strictly "less than" on input, to re-enter
+			 * the loop with at least one byte
+			 */
+			&& likely((endOnInput ? ip < shortiend : 1)
+				& (op <= shortoend))) {
+			/* Copy the literals */
+			memcpy(op, ip, endOnInput ? 16 : 8);
+			op += length;
+			ip += length;
+
+			/*
+			 * The second stage: prepare for match copying,
+			 * decode full info. If it doesn't work out,
+			 * the info won't be wasted.
+			 */
+			length = token & ML_MASK;
+			offset = LZ4_readLE16(ip);
+			ip += 2;
+			match = op - offset;
+
+			/* Do not deal with overlapping matches. */
+			if ((length != ML_MASK)
+				&& (offset >= 8)
+				&& (dict == withPrefix64k || match >= lowPrefix)) {
+				/* Copy the match. */
+				memcpy(op + 0, match + 0, 8);
+				memcpy(op + 8, match + 8, 8);
+				memcpy(op + 16, match + 16, 2);
+				op += length + MINMATCH;
+				/* Both stages worked, load the next token. */
+				continue;
+			}
+
+			/*
+			 * The second stage didn't work out, but the info
+			 * is ready. Propel it right to the point of match
+			 * copying.
+			 */
+			goto _copy_match;
+		}
+
+		/* decode literal length */
 		if (length == RUN_MASK) {
 			unsigned int s;
 
+			if (unlikely(endOnInput ? ip >= iend - RUN_MASK : 0)) {
+				/* overflow detection */
+				goto _output_error;
+			}
+
 			do {
 				s = *ip++;
 				length += s;
@@ -140,16 +207,17 @@ static FORCE_INLINE int LZ4_decompress_generic(
 
 		/* copy literals */
 		cpy = op + length;
-		if (((endOnInput) && ((cpy > (partialDecoding ? oexit : oend - MFLIMIT))
+		if (((endOnInput) && ((cpy > oend - MFLIMIT)
 			|| (ip + length > iend - (2 + 1 + LASTLITERALS))))
 			|| ((!endOnInput) && (cpy > oend - WILDCOPYLENGTH))) {
 			if (partialDecoding) {
 				if (cpy > oend) {
 					/*
-					 * Error :
-					 * write attempt beyond end of output buffer
+					 * Partial decoding :
+					 * stop in the middle of literal segment
 					 */
-					goto _output_error;
+					cpy = oend;
+					length = oend - op;
 				}
 				if ((endOnInput)
 					&& (ip + length > iend)) {
@@ -184,29 +252,44 @@ static FORCE_INLINE int LZ4_decompress_generic(
 			memcpy(op, ip, length);
 			ip += length;
 			op += length;
-			/* Necessarily EOF, due to parsing restrictions */
-			break;
-		}
 
-		LZ4_wildCopy(op, ip, cpy);
-		ip += length;
-		op = cpy;
+			/*
+			 * Necessarily EOF when !partialDecoding. When
+			 * partialDecoding, it is EOF if we've either filled
+			 * the output buffer or can't read the offset of a
+			 * following match.
+			 */
+			if (!partialDecoding || (cpy == oend)
+				|| (ip >= (iend - 2)))
+				break;
+		} else {
+			LZ4_wildCopy(op, ip, cpy);
+			ip += length;
+			op = cpy;
+		}
 
 		/* get offset */
 		offset = LZ4_readLE16(ip);
 		ip += 2;
 		match = op - offset;
 
+		/* get matchlength */
+		length = token & ML_MASK;
+
+_copy_match:
 		if ((checkOffset) && (unlikely(match < lowLimit))) {
 			/* Error : offset outside buffers */
 			goto _output_error;
 		}
 
-		/* costs ~1%; silence an msan warning when offset == 0 */
-		LZ4_write32(op, (U32)offset);
+		/*
+		 * costs ~1%; silence an msan warning when offset == 0.
+		 * When partialDecoding, there is no guarantee that
+		 * 4 bytes remain available in the output buffer.
+		 */
+		if (!partialDecoding)
+			LZ4_write32(op, (U32)offset);
 
-		/* get matchlength */
-		length = token & ML_MASK;
 		if (length == ML_MASK) {
 			unsigned int s;
 
@@ -233,7 +316,9 @@ static FORCE_INLINE int LZ4_decompress_generic(
 		if ((dict == usingExtDict) && (match < lowPrefix)) {
 			if (unlikely(op + length > oend - LASTLITERALS)) {
 				/* doesn't respect parsing restriction */
-				goto _output_error;
+				if (!partialDecoding)
+					goto _output_error;
+				length = min(length, (size_t)(oend - op));
 			}
 
 			if (length <= (size_t)(lowPrefix - match)) {
@@ -268,12 +353,38 @@ static FORCE_INLINE int LZ4_decompress_generic(
 				}
 			}
 
+			if (partialDecoding && op == oend)
+				break;
 			continue;
 		}
 
 		/* copy match within block */
 		cpy = op + length;
 
+		/*
+		 * Partial decoding : the end of the output may be in the
+		 * middle of this match, so the parsing restrictions for
+		 * the end of a block don't hold. Copy byte by byte.
+		 */
+		if (partialDecoding
+			&& (cpy > oend - MATCH_SAFEGUARD_DISTANCE)) {
+			size_t const mlen = min(length, (size_t)(oend - op));
+			const BYTE * const matchEnd = match + mlen;
+			BYTE * const copyEnd = op + mlen;
+
+			if (matchEnd > op) {
+				/* overlap copy */
+				while (op < copyEnd)
+					*op++ = *match++;
+			} else {
+				memcpy(op, match, mlen);
+			}
+			op = copyEnd;
+			if (op == oend)
+				break;
+			continue;
+		}
+
 		if (unlikely(offset < 8)) {
 			const int dec64 = dec64table[offset];
 
@@ -291,7 +402,7 @@ static FORCE_INLINE int LZ4_decompress_generic(
 
 		op += 8;
 
-		if (unlikely(cpy > oend - 12)) {
+		if (unlikely(cpy > oend - MATCH_SAFEGUARD_DISTANCE)) {
 			BYTE * const oCopyLimit = oend - (WILDCOPYLENGTH - 1);
 
 			if (cpy > oend - LASTLITERALS) {
@@ -338,22 +449,23 @@ int LZ4_decompress_safe(const char *source, char *dest,
 	int compressedSize, int maxDecompressedSize)
 {
 	return LZ4_decompress_generic(source, dest, compressedSize,
-		maxDecompressedSize, endOnInputSize, full, 0,
+		maxDecompressedSize, endOnInputSize, full,
 		noDict, (BYTE *)dest, NULL, 0);
 }
 
 int LZ4_decompress_safe_partial(const char *source, char *dest,
 	int compressedSize, int targetOutputSize, int maxDecompressedSize)
 {
+	maxDecompressedSize = min(targetOutputSize, maxDecompressedSize);
 	return LZ4_decompress_generic(source, dest, compressedSize,
 		maxDecompressedSize, endOnInputSize, partial,
-		targetOutputSize, noDict, (BYTE *)dest, NULL, 0);
+		noDict, (BYTE *)dest, NULL, 0);
 }
 
 int LZ4_decompress_fast(const char *source, char *dest, int originalSize)
 {
 	return LZ4_decompress_generic(source, dest, 0, originalSize,
-		endOnOutputSize, full, 0, withPrefix64k,
+		endOnOutputSize, full, withPrefix64k,
 		(BYTE *)(dest - 64 * KB), NULL, 64 * KB);
 }
 
@@ -389,7 +501,7 @@ int LZ4_decompress_safe_continue(LZ4_streamDecode_t *LZ4_streamDecode,
 		result = LZ4_decompress_generic(source, dest,
 			compressedSize,
 			maxOutputSize,
-			endOnInputSize, full, 0,
+			endOnInputSize, full,
 			usingExtDict, lz4sd->prefixEnd - lz4sd->prefixSize,
 			lz4sd->externalDict,
 			lz4sd->extDictSize);
@@ -404,7 +516,7 @@ int LZ4_decompress_safe_continue(LZ4_streamDecode_t *LZ4_streamDecode,
 		lz4sd->externalDict = lz4sd->prefixEnd - lz4sd->extDictSize;
 		result = LZ4_decompress_generic(source, dest,
 			compressedSize, maxOutputSize,
-			endOnInputSize, full, 0,
+			endOnInputSize, full,
 			usingExtDict, (BYTE *)dest,
 			lz4sd->externalDict, lz4sd->extDictSize);
 		if (result <= 0)
@@ -424,7 +536,7 @@ int LZ4_decompress_fast_continue(LZ4_streamDecode_t *LZ4_streamDecode,
 
 	if (lz4sd->prefixEnd == (BYTE *)dest) {
 		result = LZ4_decompress_generic(source, dest, 0, originalSize,
-			endOnOutputSize, full, 0,
+			endOnOutputSize, full,
 			usingExtDict,
 			lz4sd->prefixEnd - lz4sd->prefixSize,
 			lz4sd->externalDict, lz4sd->extDictSize);
@@ -438,7 +550,7 @@ int LZ4_decompress_fast_continue(LZ4_streamDecode_t *LZ4_streamDecode,
 		lz4sd->extDictSize = lz4sd->prefixSize;
 		lz4sd->externalDict = lz4sd->prefixEnd - lz4sd->extDictSize;
 		result = LZ4_decompress_generic(source, dest, 0, originalSize,
-			endOnOutputSize, full, 0,
+			endOnOutputSize, full,
 			usingExtDict, (BYTE *)dest,
 			lz4sd->externalDict, lz4sd->extDictSize);
 		if (result <= 0)
@@ -462,19 +574,19 @@ static FORCE_INLINE int LZ4_decompress_usingDict_generic(const char *source,
 {
 	if (dictSize == 0)
 		return LZ4_decompress_generic(source, dest,
-			compressedSize, maxOutputSize, safe, full, 0,
+			compressedSize, maxOutputSize, safe, full,
 			noDict, (BYTE *)dest, NULL, 0);
 	if (dictStart + dictSize == dest) {
 		if (dictSize >= (int)(64 * KB - 1))
 			return LZ4_decompress_generic(source, dest,
-				compressedSize, maxOutputSize, safe, full, 0,
+				compressedSize, maxOutputSize, safe, full,
 				withPrefix64k, (BYTE *)dest - 64 * KB, NULL, 0);
 		return LZ4_decompress_generic(source, dest, compressedSize,
-			maxOutputSize, safe, full, 0, noDict,
+			maxOutputSize, safe, full, noDict,
 			(BYTE *)dest - dictSize, NULL, 0);
 	}
 	return LZ4_decompress_generic(source, dest, compressedSize,
-		maxOutputSize, safe, full, 0, usingExtDict,
+		maxOutputSize, safe, full, usingExtDict,
 		(BYTE *)dest, (const BYTE *)dictStart, dictSize);
 }
 
@@ -0,0 +1,139 @@
+/* -*- linux-c -*- ------------------------------------------------------- *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 53 Temple Place Ste 330,
+ *   Boston MA 02111-1307, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * raid6/test/recovbench.c
+ *
+ * Check that every available recovery algorithm restores the original
+ * data, and measure its throughput for dual data and data+P failures.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <linux/raid/pq.h>
+
+#define NDISKS		16	/* Including P and Q */
+#define BENCH_LOOPS	20000
+
+const char raid6_empty_zero_page[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+static char *dataptrs[NDISKS];
+static char data[NDISKS][PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+static char recovi[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+static char recovj[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+static void makedata(void)
+{
+	int i, j;
+
+	for (i = 0; i < NDISKS; i++) {
+		for (j = 0; j < PAGE_SIZE; j++)
+			data[i][j] = rand();
+
+		dataptrs[i] = data[i];
+	}
+}
+
+static int test_disks(const struct raid6_recov_calls *ra, int i, int j)
+{
+	int erra, errb;
+
+	memset(recovi, 0xf0, PAGE_SIZE);
+	memset(recovj, 0xba, PAGE_SIZE);
+
+	dataptrs[i] = recovi;
+	dataptrs[j] = recovj;
+
+	if (j == NDISKS - 2)
+		ra->datap(NDISKS, PAGE_SIZE, i, (void **)&dataptrs);
+	else
+		ra->data2(NDISKS, PAGE_SIZE, i, j, (void **)&dataptrs);
+
+	erra = memcmp(data[i], recovi, PAGE_SIZE);
+	errb = memcmp(data[j], recovj, PAGE_SIZE);
+
+	dataptrs[i] = data[i];
+	dataptrs[j] = data[j];
+
+	if (erra || errb)
+		printf("%s: recovery of disks %d/%d FAILED\n", ra->name, i, j);
+
+	return !!erra + !!errb;
+}
+
+static double bench(void (*fn)(const struct raid6_recov_calls *, int, int),
+		    const struct raid6_recov_calls *ra, int i, int j)
+{
+	struct timespec start, end;
+	double ns;
+	int n;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < BENCH_LOOPS; n++)
+		fn(ra, i, j);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ns = (end.tv_sec - start.tv_sec) * 1e9 +
+	     (end.tv_nsec - start.tv_nsec);
+
+	/* MB/s of reconstructed data */
+	return (double)BENCH_LOOPS * PAGE_SIZE * (j == NDISKS - 2 ? 1 : 2) *
+	       1e3 / ns;
+}
+
+static void run_data2(const struct raid6_recov_calls *ra, int i, int j)
+{
+	ra->data2(NDISKS, PAGE_SIZE, i, j, (void **)&dataptrs);
+}
+
+static void run_datap(const struct raid6_recov_calls *ra, int i, int j)
+{
+	ra->datap(NDISKS, PAGE_SIZE, i, (void **)&dataptrs);
+}
+
+int main(int argc, char *argv[])
+{
+	const struct raid6_recov_calls *const *ra;
+	int i, j, err = 0;
+
+	makedata();
+
+	/* Also selects raid6_call, which every recovery routine relies on */
+	if (raid6_select_algo())
+		return 1;
+
+	for (ra = raid6_recov_algos; *ra; ra++) {
+		if ((*ra)->valid && !(*ra)->valid())
+			continue;
+
+		raid6_call.gen_syndrome(NDISKS, PAGE_SIZE, (void **)&dataptrs);
+
+		for (i = 0; i < NDISKS - 1; i++)
+			for (j = i + 1; j < NDISKS - 1; j++)
+				err += test_disks(*ra, i, j);
+
+		/* Recovery works in place, so benchmark on scratch pages */
+		dataptrs[0] = recovi;
+		dataptrs[1] = recovj;
+		printf("raid6: %-8s 2data %8.1f MB/s, datap %8.1f MB/s\n",
+		       (*ra)->name,
+		       bench(run_data2, *ra, 0, 1),
+		       bench(run_datap, *ra, 0, NDISKS - 2));
+		dataptrs[0] = data[0];
+		dataptrs[1] = data[1];
+	}
+
+	if (err)
+		printf("raid6: recovery benchmark found %d ERRORS\n", err);
+
+	return err != 0;
+}
@@ -14,6 +14,10 @@ EXPORT_SYMBOL(xz_dec_init);
 EXPORT_SYMBOL(xz_dec_reset);
 EXPORT_SYMBOL(xz_dec_run);
 EXPORT_SYMBOL(xz_dec_end);
+EXPORT_SYMBOL(xz_dec_lzma2_create);
+EXPORT_SYMBOL(xz_dec_lzma2_reset);
+EXPORT_SYMBOL(xz_dec_lzma2_run);
+EXPORT_SYMBOL(xz_dec_lzma2_end);
 
 MODULE_DESCRIPTION("XZ decompressor");
 MODULE_VERSION("1.0");
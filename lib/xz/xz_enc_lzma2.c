@@ -0,0 +1,765 @@
+/*
+ * LZMA2 encoder
+ *
+ * Based on the LZMA2 decoder by Lasse Collin and Igor Pavlov.
+ *
+ * This is a single-call encoder meant for compressing small and medium
+ * sized buffers such as zram pages or pstore records. It uses hash chains
+ * for match finding and a greedy parser with optional one-byte lazy
+ * evaluation, which is much cheaper than the optimal parser of liblzma
+ * while still giving a clearly better ratio than the LZ77-only algorithms
+ * available in the kernel. The output is a raw LZMA2 stream that can be
+ * decoded with xz_dec_lzma2_run().
+ *
+ * This file has been put into the public domain.
+ * You can do whatever you want with this file.
+ */
+
+#include "xz_private.h"
+#include "xz_lzma2.h"
+
+/*
+ * Maximum compressed and uncompressed sizes of one LZMA chunk. The
+ * uncompressed limit leaves room for one maximum length match so that the
+ * inner loop doesn't need to clamp match lengths to the chunk boundary.
+ */
+#define LZMA2_CHUNK_MAX (1 << 16)
+#define LZMA2_UNCOMPRESSED_MAX ((1 << 21) - MATCH_LEN_MAX)
+
+/* Maximum size of an uncompressed chunk */
+#define LZMA2_COPY_MAX (1 << 16)
+
+/* Size of LZMA chunk header: control, 2 x 16-bit sizes, properties */
+#define LZMA2_HEADER_LZMA 6
+
+/* Size of uncompressed chunk header: control and 16-bit size */
+#define LZMA2_HEADER_COPY 3
+
+/*
+ * Upper bound of the range encoder output for one LZMA symbol. A modelled
+ * bit costs at most log2(2048 / 31) ~= 6.05 bits and a direct bit exactly
+ * one, so even a far match stays around 20 bytes. The range encoder flush
+ * adds another five bytes.
+ */
+#define RC_SYMBOL_MAX 40
+#define RC_FLUSH_BYTES 5
+
+/* lc = 3, lp = 0, pb = 2, the same defaults as liblzma */
+#define LZMA_LC 3
+#define LZMA_PB 2
+#define LZMA_PROPS ((LZMA_PB * 5) * 9 + LZMA_LC)
+#define LZMA_POS_MASK ((1 << LZMA_PB) - 1)
+
+/* The match finder hashes three bytes; shorter matches come from reps. */
+#define MF_MIN_LEN 3
+#define MF_HASH_BITS_MIN 10
+#define MF_HASH_BITS_MAX 16
+
+/*
+ * A length-3 match with a far distance usually costs more bits than three
+ * literals.
+ */
+#define MF_FAR_DIST (1 << 14)
+
+struct lzma2_preset {
+	/* log2 of the history window, also stored as the dictionary size */
+	uint8_t window_bits;
+
+	/* Stop searching as soon as a match of this length is found. */
+	uint16_t nice_len;
+
+	/* Maximum number of hash chain entries to visit */
+	uint16_t depth;
+
+	/* Check if deferring a match by one byte gives a longer one. */
+	bool lazy;
+};
+
+static const struct lzma2_preset lzma2_presets[XZ_PRESET_MAX + 1] = {
+	{ 16,  16,   4, false },
+	{ 16,  32,   8, false },
+	{ 17,  32,  16, false },
+	{ 17,  64,  16, true },
+	{ 18,  64,  32, true },
+	{ 18, 128,  48, true },
+	{ 19, 128,  64, true },
+	{ 19, 273, 128, true },
+	{ 20, 273, 256, true },
+	{ 20, 273, 512, true },
+};
+
+struct rc_enc {
+	uint64_t low;
+	uint32_t range;
+	uint8_t cache;
+	uint32_t cache_size;
+
+	uint8_t *out;
+	size_t out_pos;
+};
+
+struct lzma_len_enc {
+	uint16_t choice;
+	uint16_t choice2;
+	uint16_t low[POS_STATES_MAX][LEN_LOW_SYMBOLS];
+	uint16_t mid[POS_STATES_MAX][LEN_MID_SYMBOLS];
+	uint16_t high[LEN_HIGH_SYMBOLS];
+};
+
+/*
+ * The probability arrays use the same layout as struct lzma_dec so that
+ * they can be initialized with a single loop.
+ */
+struct lzma_enc {
+	uint32_t reps[REPS];
+	enum lzma_state state;
+
+	uint16_t is_match[STATES][POS_STATES_MAX];
+	uint16_t is_rep[STATES];
+	uint16_t is_rep0[STATES];
+	uint16_t is_rep1[STATES];
+	uint16_t is_rep2[STATES];
+	uint16_t is_rep0_long[STATES][POS_STATES_MAX];
+	uint16_t dist_slot[DIST_STATES][DIST_SLOTS];
+	uint16_t dist_special[FULL_DISTANCES - DIST_MODEL_END];
+	uint16_t dist_align[ALIGN_SIZE];
+	struct lzma_len_enc match_len_enc;
+	struct lzma_len_enc rep_len_enc;
+	uint16_t literal[LITERAL_CODERS_MAX][LITERAL_CODER_SIZE];
+};
+
+struct xz_enc_lzma2 {
+	const struct lzma2_preset *preset;
+	uint32_t window_mask;
+
+	/* Input of the current call, see xz_enc_lzma2_run() */
+	const uint8_t *in;
+	uint32_t in_size;
+
+	/* Hash chain match finder */
+	uint32_t *head;
+	uint32_t *chain;
+	uint32_t hash_bits;
+	uint32_t mf_pos;
+
+	struct rc_enc rc;
+	struct lzma_enc lzma;
+
+	/* Chunk reset flags, see the control byte in xz_dec_lzma2_run() */
+	bool need_dict_reset;
+	bool need_props;
+	bool need_state_reset;
+
+	uint8_t buf[LZMA2_CHUNK_MAX + RC_SYMBOL_MAX];
+};
+
+/**************************
+ * Range encoder functions *
+ **************************/
+
+static void rc_reset(struct rc_enc *rc, uint8_t *out)
+{
+	rc->low = 0;
+	rc->range = (uint32_t)-1;
+	rc->cache = 0;
+	rc->cache_size = 1;
+	rc->out = out;
+	rc->out_pos = 0;
+}
+
+static void rc_shift_low(struct rc_enc *rc)
+{
+	if ((uint32_t)rc->low < 0xFF000000 || (uint32_t)(rc->low >> 32)) {
+		uint8_t tmp = rc->cache;
+
+		do {
+			rc->out[rc->out_pos++] = tmp + (uint8_t)(rc->low >> 32);
+			tmp = 0xFF;
+		} while (--rc->cache_size != 0);
+
+		rc->cache = (uint8_t)(rc->low >> 24);
+	}
+
+	++rc->cache_size;
+	rc->low = (rc->low & 0x00FFFFFF) << RC_SHIFT_BITS;
+}
+
+static __always_inline void rc_normalize(struct rc_enc *rc)
+{
+	if (rc->range < RC_TOP_VALUE) {
+		rc->range <<= RC_SHIFT_BITS;
+		rc_shift_low(rc);
+	}
+}
+
+static __always_inline void rc_bit(struct rc_enc *rc, uint16_t *prob,
+				   uint32_t bit)
+{
+	uint32_t bound = (rc->range >> RC_BIT_MODEL_TOTAL_BITS) * *prob;
+
+	if (!bit) {
+		rc->range = bound;
+		*prob += (RC_BIT_MODEL_TOTAL - *prob) >> RC_MOVE_BITS;
+	} else {
+		rc->low += bound;
+		rc->range -= bound;
+		*prob -= *prob >> RC_MOVE_BITS;
+	}
+
+	rc_normalize(rc);
+}
+
+/* Encode the lowest nbits of symbol, highest bit first. */
+static void rc_bittree(struct rc_enc *rc, uint16_t *probs,
+		       uint32_t nbits, uint32_t symbol)
+{
+	uint32_t i = 1;
+	uint32_t bit;
+
+	while (nbits-- > 0) {
+		bit = (symbol >> nbits) & 1;
+		rc_bit(rc, &probs[i], bit);
+		i = (i << 1) + bit;
+	}
+}
+
+/* Encode the lowest nbits of symbol, lowest bit first. */
+static void rc_bittree_reverse(struct rc_enc *rc, uint16_t *probs,
+			       uint32_t nbits, uint32_t symbol)
+{
+	uint32_t i = 1;
+	uint32_t bit;
+
+	while (nbits-- > 0) {
+		bit = symbol & 1;
+		symbol >>= 1;
+		rc_bit(rc, &probs[i], bit);
+		i = (i << 1) + bit;
+	}
+}
+
+/* Encode bits without using probabilities. */
+static void rc_direct(struct rc_enc *rc, uint32_t value, uint32_t nbits)
+{
+	while (nbits-- > 0) {
+		rc->range >>= 1;
+		if ((value >> nbits) & 1)
+			rc->low += rc->range;
+
+		rc_normalize(rc);
+	}
+}
+
+static void rc_flush(struct rc_enc *rc)
+{
+	int i;
+
+	for (i = 0; i < RC_FLUSH_BYTES; ++i)
+		rc_shift_low(rc);
+}
+
+/* Number of bytes the chunk would take if it was flushed now */
+static inline size_t rc_pending(const struct rc_enc *rc)
+{
+	return rc->out_pos + rc->cache_size + RC_FLUSH_BYTES;
+}
+
+/*************************
+ * Hash chain match finder *
+ *************************/
+
+static inline uint32_t mf_hash(const struct xz_enc_lzma2 *s, uint32_t pos)
+{
+	uint32_t v = s->in[pos] | (s->in[pos + 1] << 8)
+			| ((uint32_t)s->in[pos + 2] << 16);
+
+	return (v * 2654435761U) >> (32 - s->hash_bits);
+}
+
+static void mf_reset(struct xz_enc_lzma2 *s)
+{
+	uint32_t bits = MF_HASH_BITS_MIN;
+
+	while (bits < MF_HASH_BITS_MAX && (1U << bits) < s->in_size)
+		++bits;
+
+	s->hash_bits = bits;
+	s->mf_pos = 0;
+
+	/*
+	 * Only the head table needs clearing: a chain entry is always written
+	 * when its position is inserted, before anything can link to it.
+	 */
+	memzero(s->head, sizeof(*s->head) << bits);
+}
+
+/* Insert all positions up to but not including pos. */
+static void mf_skip_to(struct xz_enc_lzma2 *s, uint32_t pos)
+{
+	uint32_t end = s->in_size >= MF_MIN_LEN
+			? s->in_size - MF_MIN_LEN + 1 : 0;
+	uint32_t h;
+
+	if (pos > end)
+		pos = end;
+
+	while (s->mf_pos < pos) {
+		h = mf_hash(s, s->mf_pos);
+		s->chain[s->mf_pos & s->window_mask] = s->head[h];
+		s->head[h] = s->mf_pos + 1;
+		++s->mf_pos;
+	}
+}
+
+static inline uint32_t mf_match_len(const struct xz_enc_lzma2 *s,
+				    uint32_t pos, uint32_t dist,
+				    uint32_t len_max)
+{
+	const uint8_t *a = s->in + pos;
+	const uint8_t *b = a - dist;
+	uint32_t len = 0;
+
+	while (len < len_max && a[len] == b[len])
+		++len;
+
+	return len;
+}
+
+/*
+ * Find the longest match at pos. Returns the match length (zero if there
+ * is none) and stores the distance in *dist. All earlier positions must
+ * have been inserted; pos itself must not be.
+ */
+static uint32_t mf_find(struct xz_enc_lzma2 *s, uint32_t pos,
+			uint32_t len_max, uint32_t *dist)
+{
+	uint32_t window = s->window_mask + 1;
+	uint32_t depth = s->preset->depth;
+	uint32_t nice = min_t(uint32_t, s->preset->nice_len, len_max);
+	uint32_t best = 0;
+	uint32_t cur, d, len;
+
+	if (len_max < MF_MIN_LEN)
+		return 0;
+
+	cur = s->head[mf_hash(s, pos)];
+
+	while (cur != 0 && depth-- > 0) {
+		d = pos - (cur - 1);
+		if (d > window - 1)
+			break;
+
+		if (s->in[pos - d + best] == s->in[pos + best]) {
+			len = mf_match_len(s, pos, d, len_max);
+			if (len > best) {
+				best = len;
+				*dist = d;
+				if (len >= nice)
+					break;
+			}
+		}
+
+		cur = s->chain[(cur - 1) & s->window_mask];
+	}
+
+	if (best < MF_MIN_LEN || (best == MF_MIN_LEN && *dist > MF_FAR_DIST))
+		return 0;
+
+	return best;
+}
+
+/**************
+ * LZMA encoder *
+ **************/
+
+static void lzma_reset(struct xz_enc_lzma2 *s)
+{
+	uint16_t *probs = s->lzma.is_match[0];
+	size_t i;
+
+	s->lzma.state = STATE_LIT_LIT;
+	for (i = 0; i < REPS; ++i)
+		s->lzma.reps[i] = 0;
+
+	for (i = 0; i < PROBS_TOTAL; ++i)
+		probs[i] = RC_BIT_MODEL_TOTAL / 2;
+}
+
+static void lzma_literal(struct xz_enc_lzma2 *s, uint32_t pos)
+{
+	uint32_t prev_byte = pos > 0 ? s->in[pos - 1] : 0;
+	uint16_t *probs = s->lzma.literal[prev_byte >> (8 - LZMA_LC)];
+	uint32_t symbol = 1;
+	uint32_t match_byte;
+	uint32_t match_bit;
+	uint32_t offset;
+	uint32_t bit;
+	int i;
+
+	if (lzma_state_is_literal(s->lzma.state)) {
+		rc_bittree(&s->rc, probs, 8, s->in[pos]);
+	} else {
+		/* Mirror of the matched literal loop in the decoder */
+		match_byte = (uint32_t)s->in[pos - s->lzma.reps[0] - 1] << 1;
+		offset = 0x100;
+
+		for (i = 7; i >= 0; --i) {
+			bit = (s->in[pos] >> i) & 1;
+			match_bit = match_byte & offset;
+			match_byte <<= 1;
+			rc_bit(&s->rc, &probs[offset + match_bit + symbol], bit);
+			symbol = (symbol << 1) + bit;
+			if (bit)
+				offset &= match_bit;
+			else
+				offset &= ~match_bit;
+		}
+	}
+
+	lzma_state_literal(&s->lzma.state);
+}
+
+static void lzma_len(struct xz_enc_lzma2 *s, struct lzma_len_enc *l,
+		     uint32_t pos_state, uint32_t len)
+{
+	len -= MATCH_LEN_MIN;
+
+	if (len < LEN_LOW_SYMBOLS) {
+		rc_bit(&s->rc, &l->choice, 0);
+		rc_bittree(&s->rc, l->low[pos_state], LEN_LOW_BITS, len);
+	} else {
+		rc_bit(&s->rc, &l->choice, 1);
+		len -= LEN_LOW_SYMBOLS;
+
+		if (len < LEN_MID_SYMBOLS) {
+			rc_bit(&s->rc, &l->choice2, 0);
+			rc_bittree(&s->rc, l->mid[pos_state], LEN_MID_BITS,
+				   len);
+		} else {
+			rc_bit(&s->rc, &l->choice2, 1);
+			rc_bittree(&s->rc, l->high, LEN_HIGH_BITS,
+				   len - LEN_MID_SYMBOLS);
+		}
+	}
+}
+
+/* dist is the distance minus one, as stored in the reps */
+static void lzma_match(struct xz_enc_lzma2 *s, uint32_t pos_state,
+		       uint32_t dist, uint32_t len)
+{
+	uint32_t slot, footer_bits, base;
+
+	lzma_state_match(&s->lzma.state);
+	s->lzma.reps[3] = s->lzma.reps[2];
+	s->lzma.reps[2] = s->lzma.reps[1];
+	s->lzma.reps[1] = s->lzma.reps[0];
+	s->lzma.reps[0] = dist;
+
+	lzma_len(s, &s->lzma.match_len_enc, pos_state, len);
+
+	if (dist < DIST_MODEL_START) {
+		slot = dist;
+	} else {
+		footer_bits = __fls(dist);
+		slot = (footer_bits << 1) | ((dist >> (footer_bits - 1)) & 1);
+	}
+
+	rc_bittree(&s->rc, s->lzma.dist_slot[lzma_get_dist_state(len)],
+		   DIST_SLOT_BITS, slot);
+
+	if (slot < DIST_MODEL_START)
+		return;
+
+	footer_bits = (slot >> 1) - 1;
+	base = (2 | (slot & 1)) << footer_bits;
+
+	if (slot < DIST_MODEL_END) {
+		rc_bittree_reverse(&s->rc,
+				   s->lzma.dist_special + base - slot - 1,
+				   footer_bits, dist - base);
+	} else {
+		rc_direct(&s->rc, (dist - base) >> ALIGN_BITS,
+			  footer_bits - ALIGN_BITS);
+		rc_bittree_reverse(&s->rc, s->lzma.dist_align, ALIGN_BITS,
+				   dist & ALIGN_MASK);
+	}
+}
+
+/* Repeated match using reps[rep]; len == 1 means a short rep. */
+static void lzma_rep_match(struct xz_enc_lzma2 *s, uint32_t pos_state,
+			   uint32_t rep, uint32_t len)
+{
+	enum lzma_state state = s->lzma.state;
+	uint32_t dist;
+
+	if (rep == 0) {
+		rc_bit(&s->rc, &s->lzma.is_rep0[state], 0);
+		rc_bit(&s->rc, &s->lzma.is_rep0_long[state][pos_state],
+		       len != 1);
+		if (len == 1) {
+			lzma_state_short_rep(&s->lzma.state);
+			return;
+		}
+	} else {
+		dist = s->lzma.reps[rep];
+		rc_bit(&s->rc, &s->lzma.is_rep0[state], 1);
+
+		if (rep == 1) {
+			rc_bit(&s->rc, &s->lzma.is_rep1[state], 0);
+		} else {
+			rc_bit(&s->rc, &s->lzma.is_rep1[state], 1);
+			rc_bit(&s->rc, &s->lzma.is_rep2[state], rep == 3);
+			if (rep == 3)
+				s->lzma.reps[3] = s->lzma.reps[2];
+
+			s->lzma.reps[2] = s->lzma.reps[1];
+		}
+
+		s->lzma.reps[1] = s->lzma.reps[0];
+		s->lzma.reps[0] = dist;
+	}
+
+	lzma_state_long_rep(&s->lzma.state);
+	lzma_len(s, &s->lzma.rep_len_enc, pos_state, len);
+}
+
+/* Find the longest match at one of the four most recent distances. */
+static uint32_t lzma_find_rep(const struct xz_enc_lzma2 *s, uint32_t pos,
+			      uint32_t len_max, uint32_t *rep)
+{
+	uint32_t best = 0;
+	uint32_t i, dist, len;
+
+	for (i = 0; i < REPS; ++i) {
+		dist = s->lzma.reps[i] + 1;
+		if (dist > pos)
+			continue;
+
+		len = mf_match_len(s, pos, dist, len_max);
+		if (len > best) {
+			best = len;
+			*rep = i;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Encode one LZMA symbol starting at pos and return the number of input
+ * bytes it covers.
+ */
+static uint32_t lzma_encode_symbol(struct xz_enc_lzma2 *s, uint32_t pos)
+{
+	uint32_t len_max = min_t(uint32_t, s->in_size - pos, MATCH_LEN_MAX);
+	uint32_t pos_state = pos & LZMA_POS_MASK;
+	enum lzma_state state = s->lzma.state;
+	uint32_t rep = 0;
+	uint32_t rep_len;
+	uint32_t dist = 0;
+	uint32_t len;
+	uint32_t next_dist;
+
+	rep_len = lzma_find_rep(s, pos, len_max, &rep);
+
+	mf_skip_to(s, pos);
+	len = rep_len >= s->preset->nice_len ? 0
+			: mf_find(s, pos, len_max, &dist);
+
+	if (rep_len >= MATCH_LEN_MIN && rep_len + 1 >= len) {
+		rc_bit(&s->rc, &s->lzma.is_match[state][pos_state], 1);
+		rc_bit(&s->rc, &s->lzma.is_rep[state], 1);
+		lzma_rep_match(s, pos_state, rep, rep_len);
+		return rep_len;
+	}
+
+	if (len > 0 && s->preset->lazy && len < s->preset->nice_len
+			&& len < len_max) {
+		mf_skip_to(s, pos + 1);
+		if (mf_find(s, pos + 1, len_max - 1, &next_dist) > len + 1)
+			len = 0;
+	}
+
+	if (len > 0) {
+		rc_bit(&s->rc, &s->lzma.is_match[state][pos_state], 1);
+		rc_bit(&s->rc, &s->lzma.is_rep[state], 0);
+		lzma_match(s, pos_state, dist - 1, len);
+		return len;
+	}
+
+	/* A one-byte repeat is cheaper than a literal. */
+	if (pos > s->lzma.reps[0]
+			&& s->in[pos] == s->in[pos - s->lzma.reps[0] - 1]) {
+		rc_bit(&s->rc, &s->lzma.is_match[state][pos_state], 1);
+		rc_bit(&s->rc, &s->lzma.is_rep[state], 1);
+		lzma_rep_match(s, pos_state, 0, 1);
+		return 1;
+	}
+
+	rc_bit(&s->rc, &s->lzma.is_match[state][pos_state], 0);
+	lzma_literal(s, pos);
+	return 1;
+}
+
+/***************
+ * LZMA2 chunks *
+ ***************/
+
+/* Store in[start..start+size) as uncompressed chunks. */
+static bool lzma2_copy(struct xz_enc_lzma2 *s, struct xz_buf *b,
+		       uint32_t start, uint32_t size)
+{
+	uint32_t n;
+
+	while (size > 0) {
+		n = min_t(uint32_t, size, LZMA2_COPY_MAX);
+		if (b->out_size - b->out_pos < LZMA2_HEADER_COPY + n)
+			return false;
+
+		b->out[b->out_pos++] = s->need_dict_reset ? 0x01 : 0x02;
+		b->out[b->out_pos++] = (n - 1) >> 8;
+		b->out[b->out_pos++] = (n - 1) & 0xFF;
+		memcpy(b->out + b->out_pos, s->in + start, n);
+		b->out_pos += n;
+
+		if (s->need_dict_reset) {
+			s->need_dict_reset = false;
+			s->need_props = true;
+		}
+
+		start += n;
+		size -= n;
+	}
+
+	/* The LZMA state was advanced by the discarded chunk. */
+	s->need_state_reset = true;
+	return true;
+}
+
+static bool lzma2_chunk(struct xz_enc_lzma2 *s, struct xz_buf *b,
+			uint32_t start, uint32_t size)
+{
+	size_t csize = s->rc.out_pos;
+	uint8_t control;
+
+	/* Fall back to an uncompressed chunk if LZMA didn't help. */
+	if (csize + LZMA2_HEADER_LZMA >= size + LZMA2_HEADER_COPY)
+		return lzma2_copy(s, b, start, size);
+
+	if (b->out_size - b->out_pos < LZMA2_HEADER_LZMA + csize)
+		return false;
+
+	if (s->need_dict_reset)
+		control = 0xE0;
+	else if (s->need_props)
+		control = 0xC0;
+	else if (s->need_state_reset)
+		control = 0xA0;
+	else
+		control = 0x80;
+
+	b->out[b->out_pos++] = control | ((size - 1) >> 16);
+	b->out[b->out_pos++] = ((size - 1) >> 8) & 0xFF;
+	b->out[b->out_pos++] = (size - 1) & 0xFF;
+	b->out[b->out_pos++] = (csize - 1) >> 8;
+	b->out[b->out_pos++] = (csize - 1) & 0xFF;
+	if (control >= 0xC0)
+		b->out[b->out_pos++] = LZMA_PROPS;
+
+	memcpy(b->out + b->out_pos, s->buf, csize);
+	b->out_pos += csize;
+
+	s->need_dict_reset = false;
+	s->need_props = false;
+	s->need_state_reset = false;
+	return true;
+}
+
+enum xz_ret xz_enc_lzma2_run(struct xz_enc_lzma2 *s, struct xz_buf *b)
+{
+	size_t out_start = b->out_pos;
+	uint32_t pos = 0;
+	uint32_t start;
+
+	if (b->in_size - b->in_pos > U32_MAX - LZMA2_CHUNK_MAX)
+		return XZ_OPTIONS_ERROR;
+
+	s->in = b->in + b->in_pos;
+	s->in_size = b->in_size - b->in_pos;
+	s->need_dict_reset = true;
+	s->need_props = true;
+	s->need_state_reset = true;
+	mf_reset(s);
+
+	while (pos < s->in_size) {
+		start = pos;
+		if (s->need_state_reset)
+			lzma_reset(s);
+
+		rc_reset(&s->rc, s->buf);
+
+		do {
+			pos += lzma_encode_symbol(s, pos);
+		} while (pos < s->in_size
+				&& pos - start < LZMA2_UNCOMPRESSED_MAX
+				&& rc_pending(&s->rc) + RC_SYMBOL_MAX
+					<= LZMA2_CHUNK_MAX);
+
+		rc_flush(&s->rc);
+
+		if (!lzma2_chunk(s, b, start, pos - start))
+			goto error;
+	}
+
+	if (b->out_pos == b->out_size)
+		goto error;
+
+	b->out[b->out_pos++] = 0x00;
+	b->in_pos = b->in_size;
+	return XZ_STREAM_END;
+
+error:
+	b->out_pos = out_start;
+	return XZ_BUF_ERROR;
+}
+
+uint8_t xz_enc_lzma2_props(const struct xz_enc_lzma2 *s)
+{
+	/* Dictionary size 2^n is encoded as (n - 12) * 2. */
+	return (s->preset->window_bits - 12) * 2;
+}
+
+struct xz_enc_lzma2 *xz_enc_lzma2_init(uint32_t preset)
+{
+	struct xz_enc_lzma2 *s;
+	size_t window;
+
+	if (preset > XZ_PRESET_MAX)
+		return NULL;
+
+	s = vmalloc(sizeof(*s));
+	if (s == NULL)
+		return NULL;
+
+	s->preset = &lzma2_presets[preset];
+	window = (size_t)1 << s->preset->window_bits;
+	s->window_mask = window - 1;
+
+	s->head = vmalloc(sizeof(*s->head) << MF_HASH_BITS_MAX);
+	s->chain = vmalloc(sizeof(*s->chain) * window);
+	if (s->head == NULL || s->chain == NULL) {
+		xz_enc_lzma2_end(s);
+		return NULL;
+	}
+
+	return s;
+}
+
+void xz_enc_lzma2_end(struct xz_enc_lzma2 *s)
+{
+	if (s != NULL) {
+		vfree(s->chain);
+		vfree(s->head);
+		vfree(s);
+	}
+}
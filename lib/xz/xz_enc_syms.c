@@ -0,0 +1,23 @@
+/*
+ * LZMA2 encoder module information
+ *
+ * This file has been put into the public domain.
+ * You can do whatever you want with this file.
+ */
+
+#include <linux/module.h>
+#include <linux/xz.h>
+
+EXPORT_SYMBOL(xz_enc_lzma2_init);
+EXPORT_SYMBOL(xz_enc_lzma2_run);
+EXPORT_SYMBOL(xz_enc_lzma2_props);
+EXPORT_SYMBOL(xz_enc_lzma2_end);
+
+MODULE_DESCRIPTION("LZMA2 compressor");
+MODULE_VERSION("1.0");
+
+/*
+ * This code is in the public domain, but in Linux it's simplest to just
+ * say it's GPL and consider the authors as the copyright holders.
+ */
+MODULE_LICENSE("GPL");
@@ -50,6 +50,7 @@
 
 #include <linux/module.h>
 #include <linux/zutil.h>
+#include <asm/unaligned.h>
 #include "defutil.h"
 
 
@@ -539,6 +540,38 @@ static void lm_init(
     s->ins_h = 0;
 }
 
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+/* ===========================================================================
+ * Return the number of leading bytes that scan and match have in common,
+ * comparing a word at a time and never reading at or beyond strend.
+ */
+static inline unsigned match_extend(const Byte *scan, const Byte *match,
+				    const Byte *strend)
+{
+    const Byte *start = scan;
+    unsigned long diff;
+
+    while (scan + sizeof(unsigned long) <= strend) {
+        diff = get_unaligned((const unsigned long *)scan) ^
+               get_unaligned((const unsigned long *)match);
+        if (diff) {
+#ifdef __LITTLE_ENDIAN
+            return scan - start + (__ffs(diff) >> 3);
+#else
+            return scan - start + ((BITS_PER_LONG - 1 - __fls(diff)) >> 3);
+#endif
+        }
+        scan += sizeof(unsigned long);
+        match += sizeof(unsigned long);
+    }
+    while (scan < strend && *scan == *match) {
+        scan++;
+        match++;
+    }
+    return scan - start;
+}
+#endif
+
 /* ===========================================================================
  * Set match_start to the longest match starting at the given string and
  * return its length. Matches shorter or equal to prev_length are discarded,
@@ -655,6 +688,12 @@ static uInt longest_match(
         scan += 2, match++;
         Assert(*scan == *match, "match[2]?");
 
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+        /* Same result as the loop below: scan ends up at the first
+         * mismatch, or at strend if all of strstart+3..257 match.
+         */
+        scan += 1 + match_extend(scan + 1, match + 1, strend);
+#else
         /* We check for insufficient lookahead only every 8th comparison;
          * the 256th check will be made at strstart+258.
          */
@@ -664,6 +703,7 @@ static uInt longest_match(
                  *++scan == *++match && *++scan == *++match &&
                  *++scan == *++match && *++scan == *++match &&
                  scan < strend);
+#endif
 
         Assert(scan <= s->window+(unsigned)(s->window_size-1), "wild scan");
 
@@ -4,6 +4,7 @@
  */
 
 #include <linux/zutil.h>
+#include <asm/unaligned.h>
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
@@ -48,6 +49,17 @@ get_unaligned16(const unsigned short *p)
 #  define UP_UNALIGNED(a) get_unaligned16(++(a))
 #endif
 
+/*
+ * Copy n > 0 bytes from the sliding window to the output, and advance both
+ * pointers. The window is a separate buffer, so the copy never overlaps.
+ */
+#define WINCOPY(out, from, n) \
+	do { \
+		memcpy((out) + OFF, (from) + OFF, (n)); \
+		(out) += (n); \
+		(from) += (n); \
+	} while (0)
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -210,9 +222,7 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += wsize - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            WINCOPY(out, from, op);
                             from = out - dist;  /* rest from output */
                         }
                     }
@@ -221,16 +231,12 @@ void inflate_fast(z_streamp strm, unsigned start)
                         op -= write;
                         if (op < len) {         /* some from end of window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            WINCOPY(out, from, op);
                             from = window - OFF;
                             if (write < len) {  /* some from start of window */
                                 op = write;
                                 len -= op;
-                                do {
-                                    PUP(out) = PUP(from);
-                                } while (--op);
+                                WINCOPY(out, from, op);
                                 from = out - dist;      /* rest from output */
                             }
                         }
@@ -239,9 +245,7 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += write - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            WINCOPY(out, from, op);
                             from = out - dist;  /* rest from output */
                         }
                     }
@@ -262,6 +266,24 @@ void inflate_fast(z_streamp strm, unsigned start)
 		    unsigned long loops;
 
                     from = out - dist;          /* copy direct from output */
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+		    if (dist >= sizeof(unsigned long)) {
+			/* a word never overlaps its own source here */
+			while (len >= sizeof(unsigned long)) {
+			    put_unaligned(get_unaligned(
+					(unsigned long *)(from + OFF)),
+					(unsigned long *)(out + OFF));
+			    out += sizeof(unsigned long);
+			    from += sizeof(unsigned long);
+			    len -= sizeof(unsigned long);
+			}
+			while (len) {
+			    PUP(out) = PUP(from);
+			    len--;
+			}
+			continue;
+		    }
+#endif
 		    /* minimum length is three */
 		    /* Align out addr */
 		    if (!((long)(out - 1 + OFF) & 1)) {
@@ -413,6 +413,18 @@ enum perf_event_ioc_flags {
 	PERF_IOC_FLAG_GROUP		= 1U << 0,
 };
 
+/*
+ * Once the ring buffer is mmap()ed, its contents can also be moved into a
+ * pipe with splice(2) instead of being copied out of the mapping. The
+ * splice offset is the position in the data area, i.e. a value between
+ * data_tail and data_head; or, with PERF_SPLICE_AUX set, the position in
+ * the AUX area between aux_tail and aux_head. The pages are passed to the
+ * pipe as they are; the reader still advances data_tail (aux_tail), and
+ * must only do so once the data has left the pipe. Overwrite mode
+ * buffers cannot be spliced.
+ */
+#define PERF_SPLICE_AUX			(1ULL << 62)
+
 /*
  * Structure of the page that can be mapped via mmap
  */
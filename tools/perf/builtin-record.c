@@ -43,6 +43,7 @@
 #include "asm/bug.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <poll.h>
 #include <unistd.h>
@@ -78,6 +79,11 @@ struct record {
 	bool			no_buildid_cache_set;
 	bool			buildid_all;
 	bool			timestamp_filename;
+	bool			splice;
+	int			splice_pipe[2];
+	int			*splice_fds;
+	int			splice_aux_fd;
+	struct auxtrace_mmap	*splice_aux_mm;
 	struct switch_output	switch_output;
 	unsigned long long	samples;
 };
@@ -120,6 +126,47 @@ static int record__write(struct record *rec, void *bf, size_t size)
 	return 0;
 }
 
+/*
+ * Move @size bytes at ring buffer position @pos of the event behind @fd
+ * to the output through the splice pipe, without copying them out of the
+ * mmap. The pipe is drained before returning, so the caller may advance
+ * the ring buffer tail afterwards.
+ */
+static int record__splice(struct record *rec, int fd, u64 pos, size_t size)
+{
+	int out = perf_data_file__fd(rec->session->file);
+	loff_t off = pos;
+	size_t left = size;
+
+	while (left) {
+		ssize_t in, n;
+
+		in = splice(fd, &off, rec->splice_pipe[1], NULL, left,
+			    SPLICE_F_MOVE);
+		if (in <= 0)
+			goto err;
+		left -= in;
+
+		while (in) {
+			n = splice(rec->splice_pipe[0], NULL, out, NULL, in,
+				   SPLICE_F_MOVE);
+			if (n <= 0)
+				goto err;
+			in -= n;
+		}
+	}
+
+	rec->bytes_written += size;
+
+	if (switch_output_size(rec))
+		trigger_hit(&switch_output_trigger);
+
+	return 0;
+err:
+	pr_err("failed to splice perf data, error: %m\n");
+	return -1;
+}
+
 static int process_synthesized_event(struct perf_tool *tool,
 				     union perf_event *event,
 				     struct perf_sample *sample __maybe_unused,
@@ -178,7 +225,7 @@ rb_find_range(void *data, int mask, u64 head, u64 old,
 
 static int
 record__mmap_read(struct record *rec, struct perf_mmap *md,
-		  bool overwrite, bool backward)
+		  bool overwrite, bool backward, int splice_fd)
 {
 	u64 head = perf_mmap__read_head(md);
 	u64 old = md->prev;
@@ -206,6 +253,14 @@ record__mmap_read(struct record *rec, struct perf_mmap *md,
 		return 0;
 	}
 
+	/* The kernel takes care of the wrap around */
+	if (splice_fd >= 0 && !overwrite && !backward) {
+		rc = record__splice(rec, splice_fd, start, size);
+		if (rc < 0)
+			goto out;
+		goto consume;
+	}
+
 	if ((start & md->mask) + size != (end & md->mask)) {
 		buf = &data[start & md->mask];
 		size = md->mask + 1 - (start & md->mask);
@@ -226,6 +281,7 @@ record__mmap_read(struct record *rec, struct perf_mmap *md,
 		goto out;
 	}
 
+consume:
 	md->prev = head;
 	perf_mmap__consume(md, overwrite || backward);
 out:
@@ -292,21 +348,39 @@ static int record__process_auxtrace(struct perf_tool *tool,
 		padding = 8 - padding;
 
 	record__write(rec, event, event->header.size);
-	record__write(rec, data1, len1);
-	if (len2)
-		record__write(rec, data2, len2);
+	if (rec->splice_aux_fd >= 0) {
+		struct auxtrace_mmap *mm = rec->splice_aux_mm;
+		struct perf_event_mmap_page *pc = mm->userpg;
+		u64 off = (unsigned char *)data1 - (unsigned char *)mm->base;
+		u64 tail = pc->aux_tail;
+		u64 pos;
+
+		/* data1 and data2 are contiguous in the AUX stream */
+		pos = tail + (off + mm->len - tail % mm->len) % mm->len;
+		if (record__splice(rec, rec->splice_aux_fd,
+				   PERF_SPLICE_AUX | pos, len1 + len2) < 0)
+			return -1;
+	} else {
+		record__write(rec, data1, len1);
+		if (len2)
+			record__write(rec, data2, len2);
+	}
 	record__write(rec, &pad, padding);
 
 	return 0;
 }
 
 static int record__auxtrace_mmap_read(struct record *rec,
-				      struct auxtrace_mmap *mm)
+				      struct auxtrace_mmap *mm, int splice_fd)
 {
 	int ret;
 
+	rec->splice_aux_fd = splice_fd;
+	rec->splice_aux_mm = mm;
 	ret = auxtrace_mmap__read(mm, rec->itr, &rec->tool,
 				  record__process_auxtrace);
+	rec->splice_aux_fd = -1;
+	rec->splice_aux_mm = NULL;
 	if (ret < 0)
 		return ret;
 
@@ -423,6 +497,53 @@ static int record__mmap(struct record *rec)
 	return record__mmap_evlist(rec, rec->evlist);
 }
 
+/*
+ * With --splice the ring buffers go to the output file through a pipe
+ * with splice(2). Any fd of the events sharing a ring buffer can be
+ * spliced from, take the first one polled for each mmap.
+ */
+static int record__splice_init(struct record *rec)
+{
+	struct perf_evlist *evlist = rec->evlist;
+	struct fdarray *fda = &evlist->pollfd;
+	int i;
+
+	rec->splice_fds = calloc(evlist->nr_mmaps, sizeof(int));
+	if (!rec->splice_fds)
+		return -ENOMEM;
+
+	for (i = 0; i < evlist->nr_mmaps; i++)
+		rec->splice_fds[i] = -1;
+
+	for (i = 0; i < fda->nr; i++) {
+		int idx = fda->priv[i].idx;
+
+		if (idx >= 0 && idx < evlist->nr_mmaps &&
+		    rec->splice_fds[idx] < 0)
+			rec->splice_fds[idx] = fda->entries[i].fd;
+	}
+
+	if (pipe(rec->splice_pipe) < 0) {
+		pr_err("failed to create splice pipe, error: %m\n");
+		zfree(&rec->splice_fds);
+		return -errno;
+	}
+
+	/* A bigger pipe takes fewer round trips per ring buffer */
+	fcntl(rec->splice_pipe[1], F_SETPIPE_SZ, 1024 * 1024);
+	return 0;
+}
+
+static void record__splice_exit(struct record *rec)
+{
+	if (!rec->splice_fds)
+		return;
+
+	close(rec->splice_pipe[0]);
+	close(rec->splice_pipe[1]);
+	zfree(&rec->splice_fds);
+}
+
 static int record__open(struct record *rec)
 {
 	char msg[BUFSIZ];
@@ -472,6 +593,12 @@ static int record__open(struct record *rec)
 	if (rc)
 		goto out;
 
+	if (rec->splice) {
+		rc = record__splice_init(rec);
+		if (rc)
+			goto out;
+	}
+
 	session->evlist = evlist;
 	perf_session__set_id_hdr_size(session);
 out:
@@ -574,17 +701,18 @@ static int record__mmap_read_evlist(struct record *rec, struct perf_evlist *evli
 
 	for (i = 0; i < evlist->nr_mmaps; i++) {
 		struct auxtrace_mmap *mm = &maps[i].auxtrace_mmap;
+		int splice_fd = rec->splice_fds ? rec->splice_fds[i] : -1;
 
 		if (maps[i].base) {
-			if (record__mmap_read(rec, &maps[i],
-					      evlist->overwrite, backward) != 0) {
+			if (record__mmap_read(rec, &maps[i], evlist->overwrite,
+					      backward, splice_fd) != 0) {
 				rc = -1;
 				goto out;
 			}
 		}
 
 		if (mm->base && !rec->opts.auxtrace_snapshot_mode &&
-		    record__auxtrace_mmap_read(rec, mm) != 0) {
+		    record__auxtrace_mmap_read(rec, mm, splice_fd) != 0) {
 			rc = -1;
 			goto out;
 		}
@@ -1211,6 +1339,7 @@ static int __cmd_record(struct record *rec, int argc, const char **argv)
 	}
 
 out_delete_session:
+	record__splice_exit(rec);
 	perf_session__delete(session);
 	return status;
 }
@@ -1523,6 +1652,7 @@ static struct record record = {
 		},
 		.proc_map_timeout     = 500,
 	},
+	.splice_aux_fd = -1,
 	.tool = {
 		.sample		= process_sample_event,
 		.fork		= perf_event__process_fork,
@@ -1667,6 +1797,8 @@ static struct option __record_options[] = {
 			  &record.switch_output.set, "signal,size,time",
 			  "Switch output when receive SIGUSR2 or cross size,time threshold",
 			  "signal"),
+	OPT_BOOLEAN(0, "splice", &record.splice,
+		    "move ring buffer data to the output with splice(2) instead of copying it"),
 	OPT_BOOLEAN(0, "dry-run", &dry_run,
 		    "Parse options then exit"),
 	OPT_END()